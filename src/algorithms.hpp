@@ -0,0 +1,753 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+// Tag of the point-to-point messages of the in-tree algorithms
+constexpr int ALGORITHM_TAG = 7201;
+// Bytes per message of the pipelined algorithms
+constexpr int PIPELINE_SEGMENT_BYTES = 1 << 16;
+
+// Lowest set bit, the size of the binomial subtree rooted at relative position q > 0
+inline int lowest_bit(const int q)
+{
+        return q & -q;
+}
+
+// Elements of type per pipeline segment
+inline int segment_elements(const MPI_Datatype type)
+{
+        int size;
+        MPI_Type_size(type, &size);
+        return std::max(PIPELINE_SEGMENT_BYTES / std::max(size, 1), 1);
+}
+
+// Copy the own block of a process, which may already be in place
+inline void copy_block(void *dest, const void *src, const size_t bytes)
+{
+        if (dest != src) {
+                std::memcpy(dest, src, bytes);
+        }
+}
+
+enum class ScattervAlgorithm {
+        // MPI_Scatterv of the MPI library
+        library,
+        // Root sends every block directly
+        linear,
+        // Binomial tree over the ranks, every node forwards the blocks of its subtree and serves the
+        // child with the most bytes first
+        binomial,
+        // Chain from the root to the last rank, forwarded in segments of PIPELINE_SEGMENT_BYTES
+        chain,
+        // Binomial tree over the ranks sorted by decreasing count, heavy receivers are near the root
+        largest_first,
+};
+
+inline std::optional<ScattervAlgorithm> parse_scatterv_algorithm(const std::string &name)
+{
+        if (name.empty() || name == "library") {
+                return ScattervAlgorithm::library;
+        }
+        if (name == "linear") {
+                return ScattervAlgorithm::linear;
+        }
+        if (name == "binomial") {
+                return ScattervAlgorithm::binomial;
+        }
+        if (name == "chain") {
+                return ScattervAlgorithm::chain;
+        }
+        if (name == "largest-first") {
+                return ScattervAlgorithm::largest_first;
+        }
+        return std::nullopt;
+}
+
+// Point-to-point scatterv with everything that does not depend on the data planned once. Every
+// process needs the counts of all processes, as the benchmarks have them.
+class ScattervSchedule {
+        ScattervAlgorithm algorithm;
+        int rank;
+        int csize;
+        int root;
+        MPI_Comm comm;
+        MPI_Datatype type;
+        MPI_Aint extent;
+
+        std::vector<int> counts;
+        std::vector<int> displs;
+
+        // Trees: ranks in tree order, this node's parent and children with the offset and number
+        // of elements of their subtrees in the staging buffer, served in this order
+        std::vector<int> order;
+        int parent = MPI_PROC_NULL;
+        struct Child {
+                int rank;
+                int offset;
+                int elements;
+                // Blocks of the subtree straight from the send buffer, only on the root
+                MPI_Datatype blocks;
+        };
+        std::vector<Child> children;
+        int subtree = 0;
+
+        // Blocks of this process and all processes after it in the chain, or of its subtree
+        std::vector<char> stage;
+        std::vector<MPI_Request> requests;
+
+        void plan_tree()
+        {
+                // Relative position of every rank, the root is at position 0
+                order.resize(csize);
+                std::iota(order.begin(), order.end(), 0);
+                std::rotate(order.begin(), order.begin() + root, order.end());
+                if (algorithm == ScattervAlgorithm::largest_first) {
+                        std::stable_sort(order.begin() + 1, order.end(), [&](const int a, const int b) { return counts[a] > counts[b]; });
+                }
+                const int q = static_cast<int>(std::find(order.begin(), order.end(), rank) - order.begin());
+
+                auto elements = [&](const int begin, const int end)
+                {
+                        int n = 0;
+                        for (int i = begin; i < std::min(end, csize); ++i) {
+                                n += counts[order[i]];
+                        }
+                        return n;
+                };
+
+                const int span = q == 0 ? csize : lowest_bit(q);
+                subtree = elements(q, q + span);
+                if (q > 0) {
+                        parent = order[q & (q - 1)];
+                }
+                for (int bit = 1; bit < span && q + bit < csize; bit <<= 1) {
+                        const int c = q + bit;
+                        Child child{order[c], elements(q, c), elements(c, c + bit), MPI_DATATYPE_NULL};
+                        if (q == 0) {
+                                std::vector<int> lengths, offsets;
+                                for (int i = c; i < std::min(c + bit, csize); ++i) {
+                                        lengths.push_back(counts[order[i]]);
+                                        offsets.push_back(displs[order[i]]);
+                                }
+                                MPI_Type_indexed(static_cast<int>(lengths.size()), lengths.data(), offsets.data(), type, &child.blocks);
+                                MPI_Type_commit(&child.blocks);
+                        }
+                        children.push_back(child);
+                }
+                std::ranges::stable_sort(children, [](const Child &a, const Child &b) { return a.elements > b.elements; });
+
+                if (q > 0) {
+                        stage.resize(std::max<size_t>(static_cast<size_t>(subtree) * extent, 1));
+                }
+        }
+
+        void plan_chain()
+        {
+                // Elements this process receives, its own block and everything it forwards
+                subtree = 0;
+                for (int i = (rank - root + csize) % csize; i < csize; ++i) {
+                        subtree += counts[(i + root) % csize];
+                }
+                if (rank != root) {
+                        stage.resize(std::max<size_t>(static_cast<size_t>(subtree) * extent, 1));
+                } else {
+                        subtree -= counts[root];
+                        // Root sends from its buffer if the blocks are in chain order without gaps
+                        bool contiguous = true;
+                        int next = displs[(root + 1) % csize];
+                        for (int i = 1; i < csize; ++i) {
+                                const int r = (root + i) % csize;
+                                contiguous = contiguous && displs[r] == next;
+                                next = displs[r] + counts[r];
+                        }
+                        if (!contiguous) {
+                                stage.resize(std::max<size_t>(static_cast<size_t>(subtree) * extent, 1));
+                        }
+                }
+                requests.reserve(subtree / segment_elements(type) + 1);
+        }
+
+        void run_linear(const void *sendbuf, void *recvbuf)
+        {
+                if (rank != root) {
+                        if (counts[rank] > 0) {
+                                MPI_Recv(recvbuf, counts[rank], type, root, ALGORITHM_TAG, comm, MPI_STATUS_IGNORE);
+                        }
+                        return;
+                }
+                requests.clear();
+                for (int i = 0; i < csize; ++i) {
+                        if (i != root && counts[i] > 0) {
+                                MPI_Request request;
+                                MPI_Isend(static_cast<const char *>(sendbuf) + displs[i] * extent, counts[i], type, i, ALGORITHM_TAG, comm, &request);
+                                requests.push_back(request);
+                        }
+                }
+                copy_block(recvbuf, static_cast<const char *>(sendbuf) + displs[root] * extent, counts[root] * extent);
+                MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+        }
+
+        void run_tree(const void *sendbuf, void *recvbuf)
+        {
+                if (rank == root) {
+                        for (const Child &child : children) {
+                                if (child.elements > 0) {
+                                        MPI_Send(sendbuf, 1, child.blocks, child.rank, ALGORITHM_TAG, comm);
+                                }
+                        }
+                        copy_block(recvbuf, static_cast<const char *>(sendbuf) + displs[root] * extent, counts[root] * extent);
+                        return;
+                }
+                if (subtree == 0) {
+                        return;
+                }
+                MPI_Recv(stage.data(), subtree, type, parent, ALGORITHM_TAG, comm, MPI_STATUS_IGNORE);
+                for (const Child &child : children) {
+                        if (child.elements > 0) {
+                                MPI_Send(stage.data() + child.offset * extent, child.elements, type, child.rank, ALGORITHM_TAG, comm);
+                        }
+                }
+                // Own block comes first in the subtree
+                std::memcpy(recvbuf, stage.data(), counts[rank] * extent);
+        }
+
+        void run_chain(const void *sendbuf, void *recvbuf)
+        {
+                const int segment = segment_elements(type);
+                const int position = (rank - root + csize) % csize;
+                const int prev = (rank - 1 + csize) % csize;
+                const int next = position + 1 < csize ? (rank + 1) % csize : MPI_PROC_NULL;
+                requests.clear();
+
+                auto forward = [&](const char *stream, const int begin, const int end)
+                {
+                        for (int i = begin; i < end; i += segment) {
+                                MPI_Request request;
+                                MPI_Isend(stream + i * extent, std::min(segment, end - i), type, next, ALGORITHM_TAG, comm, &request);
+                                requests.push_back(request);
+                        }
+                };
+
+                if (rank == root) {
+                        const char *stream = static_cast<const char *>(sendbuf) + displs[(root + 1) % csize] * extent;
+                        if (!stage.empty()) {
+                                size_t offset = 0;
+                                for (int i = 1; i < csize; ++i) {
+                                        const int r = (root + i) % csize;
+                                        std::memcpy(stage.data() + offset, static_cast<const char *>(sendbuf) + displs[r] * extent, counts[r] * extent);
+                                        offset += counts[r] * extent;
+                                }
+                                stream = stage.data();
+                        }
+                        forward(stream, 0, subtree);
+                        copy_block(recvbuf, static_cast<const char *>(sendbuf) + displs[root] * extent, counts[root] * extent);
+                        MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+                        return;
+                }
+
+                // Forward every segment of the successor's stream as soon as it was received
+                const int own = counts[rank];
+                int received = 0, forwarded = own;
+                while (received < subtree) {
+                        const int n = std::min(segment, subtree - received);
+                        MPI_Recv(stage.data() + received * extent, n, type, prev, ALGORITHM_TAG, comm, MPI_STATUS_IGNORE);
+                        received += n;
+                        if (next != MPI_PROC_NULL) {
+                                const int end = received == subtree ? subtree : own + (received - own) / segment * segment;
+                                if (end > forwarded) {
+                                        forward(stage.data(), forwarded, end);
+                                        forwarded = end;
+                                }
+                        }
+                }
+                std::memcpy(recvbuf, stage.data(), own * extent);
+                MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+        }
+
+public:
+        ScattervSchedule(const ScattervAlgorithm algorithm,
+                         const int *sendcounts,
+                         const int *sdispls,
+                         const MPI_Datatype type,
+                         const int root = 0,
+                         const MPI_Comm comm = MPI_COMM_WORLD)
+                : algorithm(algorithm), root(root), comm(comm), type(type)
+        {
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &csize);
+                MPI_Aint lb;
+                MPI_Type_get_extent(type, &lb, &extent);
+                counts.assign(sendcounts, sendcounts + csize);
+                displs.assign(sdispls, sdispls + csize);
+
+                switch (algorithm) {
+                case ScattervAlgorithm::binomial:
+                case ScattervAlgorithm::largest_first:
+                        plan_tree();
+                        break;
+                case ScattervAlgorithm::chain:
+                        plan_chain();
+                        break;
+                default:
+                        requests.reserve(csize);
+                        break;
+                }
+        }
+
+        ScattervSchedule(const ScattervSchedule &) = delete;
+        ScattervSchedule &operator=(const ScattervSchedule &) = delete;
+
+        ~ScattervSchedule()
+        {
+                for (Child &child : children) {
+                        if (child.blocks != MPI_DATATYPE_NULL) {
+                                MPI_Type_free(&child.blocks);
+                        }
+                }
+        }
+
+        // Send buffer and displacements are only used on the root
+        void run(const void *sendbuf, void *recvbuf)
+        {
+                switch (algorithm) {
+                case ScattervAlgorithm::linear:
+                        run_linear(sendbuf, recvbuf);
+                        break;
+                case ScattervAlgorithm::binomial:
+                case ScattervAlgorithm::largest_first:
+                        run_tree(sendbuf, recvbuf);
+                        break;
+                case ScattervAlgorithm::chain:
+                        run_chain(sendbuf, recvbuf);
+                        break;
+                default:
+                        MPI_Scatterv(sendbuf, counts.data(), displs.data(), type, recvbuf, counts[rank], type, root, comm);
+                        break;
+                }
+        }
+};
+
+// Binomial tree broadcast from root on point-to-point messages
+inline void binomial_bcast(void *buffer, const int count, const MPI_Datatype type, const int root, const MPI_Comm comm)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+        const int relative = (rank - root + csize) % csize;
+
+        int mask = 1;
+        while (mask < csize) {
+                if (relative & mask) {
+                        MPI_Recv(buffer, count, type, (rank - mask + csize) % csize, ALGORITHM_TAG, comm, MPI_STATUS_IGNORE);
+                        break;
+                }
+                mask <<= 1;
+        }
+        for (mask >>= 1; mask > 0; mask >>= 1) {
+                if (relative + mask < csize) {
+                        MPI_Send(buffer, count, type, (rank + mask) % csize, ALGORITHM_TAG, comm);
+                }
+        }
+}
+
+enum class AllgathervAlgorithm {
+        // MPI_Allgatherv of the MPI library
+        library,
+        // Every process passes the block it received last to its right neighbor, p - 1 steps
+        ring,
+        // Processes exchange everything they have with a partner at distance 1, 2, 4, ..., the
+        // processes beyond the largest power of two join through a partner before and after
+        recursive_doubling,
+        // Every process sends everything it has to the process at distance 1, 2, 4, ... to the left,
+        // ceil(log2 p) steps for any p
+        bruck,
+        // Ring over the small blocks, then every large block is broadcast on its own
+        two_phase,
+};
+
+inline std::optional<AllgathervAlgorithm> parse_allgatherv_algorithm(const std::string &name)
+{
+        if (name.empty() || name == "library") {
+                return AllgathervAlgorithm::library;
+        }
+        if (name == "ring") {
+                return AllgathervAlgorithm::ring;
+        }
+        if (name == "recursive-doubling") {
+                return AllgathervAlgorithm::recursive_doubling;
+        }
+        if (name == "bruck") {
+                return AllgathervAlgorithm::bruck;
+        }
+        if (name == "two-phase") {
+                return AllgathervAlgorithm::two_phase;
+        }
+        return std::nullopt;
+}
+
+// Blocks larger than this multiple of the mean count are large in the two-phase algorithm
+constexpr int TWO_PHASE_LARGE_FACTOR = 2;
+
+// Point-to-point allgatherv planned once as a list of steps. Every step sends some blocks of the
+// receive buffer to one process and receives other blocks from another one, with datatypes that
+// pick the blocks at their displacements, so nothing is copied besides the own block.
+class AllgathervSchedule {
+        AllgathervAlgorithm algorithm;
+        int rank;
+        int csize;
+        MPI_Comm comm;
+        MPI_Datatype type;
+        MPI_Aint extent;
+
+        std::vector<int> counts;
+        std::vector<int> displs;
+
+        struct Step {
+                int dest;
+                MPI_Datatype send;
+                int source;
+                MPI_Datatype recv;
+        };
+        std::vector<Step> steps;
+        std::vector<MPI_Datatype> derived;
+        // Large blocks of the two-phase algorithm
+        std::vector<int> large;
+
+        MPI_Datatype blocks(const std::vector<int> &ranks)
+        {
+                std::vector<int> lengths, offsets;
+                for (const int r : ranks) {
+                        lengths.push_back(counts[r]);
+                        offsets.push_back(displs[r]);
+                }
+                MPI_Datatype blocks;
+                MPI_Type_indexed(static_cast<int>(ranks.size()), lengths.data(), offsets.data(), type, &blocks);
+                MPI_Type_commit(&blocks);
+                derived.push_back(blocks);
+                return blocks;
+        }
+
+        void step(const int dest, const std::vector<int> &send, const int source, const std::vector<int> &recv)
+        {
+                steps.push_back({dest,
+                                 dest == MPI_PROC_NULL ? MPI_DATATYPE_NULL : blocks(send),
+                                 source,
+                                 source == MPI_PROC_NULL ? MPI_DATATYPE_NULL : blocks(recv)});
+        }
+
+        // Ring over the given blocks, blocks of other processes are sent as empty messages
+        void plan_ring(const std::vector<bool> &included)
+        {
+                const int right = (rank + 1) % csize;
+                const int left = (rank - 1 + csize) % csize;
+                for (int k = 0; k < csize - 1; ++k) {
+                        const int send = (rank - k + csize) % csize;
+                        const int recv = (rank - k - 1 + csize) % csize;
+                        step(right,
+                             included[send] ? std::vector{send} : std::vector<int>{},
+                             left,
+                             included[recv] ? std::vector{recv} : std::vector<int>{});
+                }
+        }
+
+        void plan_recursive_doubling()
+        {
+                int pof2 = 1;
+                while (pof2 * 2 <= csize) {
+                        pof2 *= 2;
+                }
+                const int extra = csize - pof2;
+
+                // Blocks a process holds after the exchanges within groups of size d
+                auto held = [&](const int r, const int d)
+                {
+                        std::vector<int> ranks;
+                        const int first = r & ~(d - 1);
+                        for (int v = first; v < first + d; ++v) {
+                                ranks.push_back(v);
+                                if (v + pof2 < csize) {
+                                        ranks.push_back(v + pof2);
+                                }
+                        }
+                        return ranks;
+                };
+
+                if (rank >= pof2) {
+                        step(rank - pof2, {rank}, MPI_PROC_NULL, {});
+                } else if (rank < extra) {
+                        step(MPI_PROC_NULL, {}, rank + pof2, {rank + pof2});
+                }
+
+                if (rank < pof2) {
+                        for (int d = 1; d < pof2; d <<= 1) {
+                                const int partner = rank ^ d;
+                                step(partner, held(rank, d), partner, held(partner, d));
+                        }
+                }
+
+                std::vector<int> others;
+                if (rank < extra) {
+                        for (int r = 0; r < csize; ++r) {
+                                if (r != rank + pof2) {
+                                        others.push_back(r);
+                                }
+                        }
+                        step(rank + pof2, others, MPI_PROC_NULL, {});
+                } else if (rank >= pof2) {
+                        for (int r = 0; r < csize; ++r) {
+                                if (r != rank) {
+                                        others.push_back(r);
+                                }
+                        }
+                        step(MPI_PROC_NULL, {}, rank - pof2, others);
+                }
+        }
+
+        void plan_bruck()
+        {
+                for (int d = 1; d < csize; d <<= 1) {
+                        const int n = std::min(d, csize - d);
+                        std::vector<int> send, recv;
+                        for (int i = 0; i < n; ++i) {
+                                send.push_back((rank + i) % csize);
+                                recv.push_back((rank + d + i) % csize);
+                        }
+                        step((rank - d + csize) % csize, send, (rank + d) % csize, recv);
+                }
+        }
+
+        void plan_two_phase()
+        {
+                const long long total = std::accumulate(counts.begin(), counts.end(), 0LL);
+                std::vector<bool> small(csize);
+                for (int r = 0; r < csize; ++r) {
+                        small[r] = static_cast<long long>(counts[r]) * csize <= TWO_PHASE_LARGE_FACTOR * total;
+                        if (!small[r]) {
+                                large.push_back(r);
+                        }
+                }
+                plan_ring(small);
+        }
+
+public:
+        AllgathervSchedule(const AllgathervAlgorithm algorithm,
+                           const int *recvcounts,
+                           const int *rdispls,
+                           const MPI_Datatype type,
+                           const MPI_Comm comm = MPI_COMM_WORLD)
+                : algorithm(algorithm), comm(comm), type(type)
+        {
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &csize);
+                MPI_Aint lb;
+                MPI_Type_get_extent(type, &lb, &extent);
+                counts.assign(recvcounts, recvcounts + csize);
+                displs.assign(rdispls, rdispls + csize);
+
+                switch (algorithm) {
+                case AllgathervAlgorithm::ring:
+                        plan_ring(std::vector<bool>(csize, true));
+                        break;
+                case AllgathervAlgorithm::recursive_doubling:
+                        plan_recursive_doubling();
+                        break;
+                case AllgathervAlgorithm::bruck:
+                        plan_bruck();
+                        break;
+                case AllgathervAlgorithm::two_phase:
+                        plan_two_phase();
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        AllgathervSchedule(const AllgathervSchedule &) = delete;
+        AllgathervSchedule &operator=(const AllgathervSchedule &) = delete;
+
+        ~AllgathervSchedule()
+        {
+                for (MPI_Datatype &blocks : derived) {
+                        MPI_Type_free(&blocks);
+                }
+        }
+
+        void run(const void *sendbuf, void *recvbuf)
+        {
+                if (algorithm == AllgathervAlgorithm::library) {
+                        MPI_Allgatherv(sendbuf, counts[rank], type, recvbuf, counts.data(), displs.data(), type, comm);
+                        return;
+                }
+
+                copy_block(static_cast<char *>(recvbuf) + displs[rank] * extent, sendbuf, counts[rank] * extent);
+                for (const Step &s : steps) {
+                        MPI_Sendrecv(recvbuf,
+                                     s.dest == MPI_PROC_NULL ? 0 : 1,
+                                     s.dest == MPI_PROC_NULL ? type : s.send,
+                                     s.dest,
+                                     ALGORITHM_TAG,
+                                     recvbuf,
+                                     s.source == MPI_PROC_NULL ? 0 : 1,
+                                     s.source == MPI_PROC_NULL ? type : s.recv,
+                                     s.source,
+                                     ALGORITHM_TAG,
+                                     comm,
+                                     MPI_STATUS_IGNORE);
+                }
+                for (const int r : large) {
+                        binomial_bcast(static_cast<char *>(recvbuf) + displs[r] * extent, counts[r], type, r, comm);
+                }
+        }
+};
+
+enum class BcastAlgorithm {
+        // MPI_Bcast of the MPI library
+        library,
+        // Binomial tree from the root
+        binomial,
+        // Chain from the root to the last rank, forwarded in segments of PIPELINE_SEGMENT_BYTES
+        chain,
+        // van de Geijn: binomial scatter of p pieces, then a ring allgather of the pieces
+        scatter_allgather,
+};
+
+inline std::optional<BcastAlgorithm> parse_bcast_algorithm(const std::string &name)
+{
+        if (name.empty() || name == "library") {
+                return BcastAlgorithm::library;
+        }
+        if (name == "binomial") {
+                return BcastAlgorithm::binomial;
+        }
+        if (name == "chain") {
+                return BcastAlgorithm::chain;
+        }
+        if (name == "scatter-allgather") {
+                return BcastAlgorithm::scatter_allgather;
+        }
+        return std::nullopt;
+}
+
+// Point-to-point broadcast of count elements planned once
+class BcastSchedule {
+        BcastAlgorithm algorithm;
+        int rank;
+        int csize;
+        int count;
+        int root;
+        MPI_Comm comm;
+        MPI_Datatype type;
+        MPI_Aint extent;
+
+        // Pieces of the scatter-allgather algorithm
+        std::vector<int> counts;
+        std::vector<int> displs;
+        std::optional<ScattervSchedule> scatter;
+        std::optional<AllgathervSchedule> allgather;
+
+        std::vector<MPI_Request> requests;
+
+        void run_chain(void *buffer)
+        {
+                const int segment = segment_elements(type);
+                const int position = (rank - root + csize) % csize;
+                const int prev = rank == root ? MPI_PROC_NULL : (rank - 1 + csize) % csize;
+                const int next = position + 1 < csize ? (rank + 1) % csize : MPI_PROC_NULL;
+                char *data = static_cast<char *>(buffer);
+
+                requests.clear();
+                for (int i = 0; i < count; i += segment) {
+                        const int n = std::min(segment, count - i);
+                        if (prev != MPI_PROC_NULL) {
+                                MPI_Recv(data + i * extent, n, type, prev, ALGORITHM_TAG, comm, MPI_STATUS_IGNORE);
+                        }
+                        if (next != MPI_PROC_NULL) {
+                                MPI_Request request;
+                                MPI_Isend(data + i * extent, n, type, next, ALGORITHM_TAG, comm, &request);
+                                requests.push_back(request);
+                        }
+                }
+                MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+        }
+
+public:
+        BcastSchedule(const BcastAlgorithm algorithm,
+                      const int count,
+                      const MPI_Datatype type,
+                      const int root = 0,
+                      const MPI_Comm comm = MPI_COMM_WORLD)
+                : algorithm(algorithm), count(count), root(root), comm(comm), type(type)
+        {
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &csize);
+                MPI_Aint lb;
+                MPI_Type_get_extent(type, &lb, &extent);
+
+                if (algorithm == BcastAlgorithm::chain) {
+                        requests.reserve(count / segment_elements(type) + 1);
+                } else if (algorithm == BcastAlgorithm::scatter_allgather) {
+                        // Equal pieces, the last ones are shorter or empty if count is not a multiple of p
+                        const int piece = (count + csize - 1) / csize;
+                        counts.resize(csize);
+                        displs.resize(csize);
+                        for (int i = 0; i < csize; ++i) {
+                                displs[i] = std::min(i * piece, count);
+                                counts[i] = std::min(piece, count - displs[i]);
+                        }
+                        scatter.emplace(ScattervAlgorithm::binomial, counts.data(), displs.data(), type, root, comm);
+                        allgather.emplace(AllgathervAlgorithm::ring, counts.data(), displs.data(), type, comm);
+                }
+        }
+
+        void run(void *buffer)
+        {
+                switch (algorithm) {
+                case BcastAlgorithm::binomial:
+                        binomial_bcast(buffer, count, type, root, comm);
+                        break;
+                case BcastAlgorithm::chain:
+                        run_chain(buffer);
+                        break;
+                case BcastAlgorithm::scatter_allgather: {
+                        // Both steps work in place, every process keeps its piece at its displacement
+                        char *piece = static_cast<char *>(buffer) + displs[rank] * extent;
+                        scatter->run(buffer, piece);
+                        allgather->run(piece, buffer);
+                        break;
+                }
+                default:
+                        MPI_Bcast(buffer, count, type, root, comm);
+                        break;
+                }
+        }
+};
+
+// Mean latency of every algorithm and its speedup over the first one, the library's
+inline void print_algorithms(const std::vector<std::pair<std::string, double>> &latencies)
+{
+        // @formatter:off
+        std::ostringstream oss;
+        oss << std::left << std::setw(25) << "Algorithm"
+                         << std::setw(25) << "Avg Latency (μs)"
+                         << std::setw(20) << "Speedup"
+                         << std::endl;
+        for (const auto &[name, latency] : latencies) {
+                oss << std::left << std::setw(25) << name
+                                 << std::setw(25) << latency * 1e6
+                                 << std::setw(20) << (latency > 0.0 ? latencies.front().second / latency : 0.0)
+                                 << std::endl;
+        }
+        std::cout << oss.str() << std::endl;
+        // @formatter:on
+}
@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <vector>
+#include <string>
+
+#include <mpi.h>
+
+#include "largecount.hpp"
+#include "matrix.hpp"
+#include "options.hpp"
+#include "output.hpp"
+#include "overlap.hpp"
+#include "persistent.hpp"
+#include "report.hpp"
+#include "sparse.hpp"
+#include "stream.hpp"
+#include "timing.hpp"
+#include "volume.hpp"
+
+template <typename T>
+class Alltoallv {
+
+        int rank;
+        int csize;
+
+        std::vector<T> sbuffer;
+        std::vector<T> rbuffer;
+
+        std::vector<int> sendcounts;
+        std::vector<int> recvcounts;
+        std::vector<int> sdispls;
+        std::vector<int> rdispls;
+
+        // Same counts and displacements for the large-count variant
+        std::vector<MPI_Count> sendcounts_c;
+        std::vector<MPI_Count> recvcounts_c;
+        std::vector<MPI_Aint> sdispls_c;
+        std::vector<MPI_Aint> rdispls_c;
+
+        // Neighborhood and NBX variants of the same exchange
+        std::optional<SparseExchange> sparse;
+
+        TimestampArena times;
+        StreamWriter stream;
+        LatencyHistogram histogram;
+        LatencyReport report;
+        VolumeReport volume;
+
+        static MPI_Datatype get_mpi_type() {
+                if constexpr (std::is_same_v<T, int>) {
+                        return MPI_INT;
+                } else if constexpr (std::is_same_v<T, double>) {
+                        return MPI_DOUBLE;
+                } else if constexpr (std::is_same_v<T, char>) {
+                        return MPI_CHAR;
+                }
+                return MPI_DATATYPE_NULL;
+        }
+
+        // Displacements of consecutive blocks, returns the number of elements of the buffer
+        static long long layout(const std::vector<MPI_Count> &counts, std::vector<MPI_Aint> &displs)
+        {
+                long long offset = 0;
+                displs.resize(counts.size());
+                for (size_t i = 0; i < counts.size(); ++i) {
+                        displs[i] = static_cast<MPI_Aint>(offset);
+                        offset += counts[i];
+                }
+                return offset;
+        }
+
+        // Run op once on a cleared receive buffer and check that block i holds the value i, which
+        // rank i sends
+        template <typename F>
+        void verify(F &&op)
+        {
+                std::ranges::fill(rbuffer, static_cast<T>(csize));
+                op();
+
+                bool valid = true;
+                for (int i = 0; i < csize; ++i) {
+                        const T expected = static_cast<T>(i);
+                        const T *block = rbuffer.data() + rdispls_c[i];
+                        valid = valid && std::all_of(block, block + recvcounts_c[i], [&](const T x) { return x == expected; });
+                }
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Received payload does not match the send buffers" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
+        // Check the dense result, then run op once on a cleared receive buffer and compare it with
+        // that result element by element
+        template <typename F, typename G>
+        void verify_against_dense(F &&dense, G &&op)
+        {
+                verify(dense);
+                const std::vector<T> reference = rbuffer;
+                std::ranges::fill(rbuffer, static_cast<T>(csize));
+                op();
+
+                bool valid = rbuffer == reference;
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Sparse exchange does not match the result of MPI_Alltoallv" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
+        static void print_bisection(const long long bisection, const double latency)
+        {
+                // @formatter:off
+                std::ostringstream oss;
+                oss << std::left << std::setw(25) << "Bisection Bytes"
+                                 << std::setw(25) << "Bisection Rate (GB/s)"
+                                 << std::endl
+                                 << std::setw(25) << bisection
+                                 << std::setw(25) << (latency > 0.0 ? static_cast<double>(bisection) / latency * 1e-9 : 0.0)
+                                 << std::endl;
+                std::cout << oss.str() << std::endl;
+                // @formatter:on
+        }
+
+public:
+        Alltoallv(const std::string &filename, const bool large_count)
+        {
+                rank = -1;
+                csize = -1;
+
+                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+
+                if (rank == 0 && csize < 2) {
+                        std::cerr << "ERROR: Need more than one process." << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                std::vector<long long> scounts, rcounts;
+                load_m2m(filename, scounts, rcounts);
+                sendcounts_c.assign(scounts.begin(), scounts.end());
+                recvcounts_c.assign(rcounts.begin(), rcounts.end());
+
+                // No count exceeds the total, so the int arrays are valid whenever this holds
+                const long long ssize = layout(sendcounts_c, sdispls_c);
+                const long long rsize = layout(recvcounts_c, rdispls_c);
+                if (!large_count && std::max(ssize, rsize) > INT_MAX) {
+                        std::cerr << "ERROR: Displacements exceed the range of int, use --large-count" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                sdispls.assign(sdispls_c.begin(), sdispls_c.end());
+                rdispls.assign(rdispls_c.begin(), rdispls_c.end());
+                sendcounts.assign(sendcounts_c.begin(), sendcounts_c.end());
+                recvcounts.assign(recvcounts_c.begin(), recvcounts_c.end());
+
+                sbuffer.assign(std::max(ssize, 1LL), static_cast<T>(rank));
+                rbuffer.assign(std::max(rsize, 1LL), static_cast<T>(0));
+
+                if (!large_count) {
+                        sparse.emplace(sendcounts, sdispls, recvcounts, rdispls);
+                }
+
+                MPI_Barrier(MPI_COMM_WORLD);
+        }
+
+        void run(const Options &options)
+        {
+                const std::optional<Exchange> exchange = parse_exchange(options.algorithm);
+                if (!exchange) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Unknown algorithm " << options.algorithm << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                if (*exchange != Exchange::dense && options.large_count) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Option --large-count requires the dense exchange" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                if (*exchange == Exchange::nbx && options.mode != Mode::blocking) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: NBX exchange is only available in blocking mode" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                auto dense_op = [&]
+                {
+                        MPI_Alltoallv(sbuffer.data(),
+                                      sendcounts.data(),
+                                      sdispls.data(),
+                                      get_mpi_type(),
+                                      rbuffer.data(),
+                                      recvcounts.data(),
+                                      rdispls.data(),
+                                      get_mpi_type(),
+                                      MPI_COMM_WORLD);
+                };
+                auto neighbor_op = [&]
+                {
+                        sparse->neighbor(sbuffer.data(), rbuffer.data(), get_mpi_type());
+                };
+                auto nbx_op = [&]
+                {
+                        sparse->nbx(sbuffer.data(), rbuffer.data(), get_mpi_type());
+                };
+
+                auto op = [&]
+                {
+                        if (options.large_count) {
+                                alltoallv_c(sbuffer.data(),
+                                            sendcounts_c.data(),
+                                            sdispls_c.data(),
+                                            get_mpi_type(),
+                                            rbuffer.data(),
+                                            recvcounts_c.data(),
+                                            rdispls_c.data(),
+                                            get_mpi_type(),
+                                            MPI_COMM_WORLD);
+                                return;
+                        }
+                        switch (*exchange) {
+                        case Exchange::dense:
+                                dense_op();
+                                break;
+                        case Exchange::neighbor:
+                                neighbor_op();
+                                break;
+                        case Exchange::nbx:
+                                nbx_op();
+                                break;
+                        }
+                };
+
+                // Check the payload once, outside of the timed iterations. Both sparse variants are
+                // also timed with --verbose, so both have to match the dense exchange.
+                if (*exchange == Exchange::dense) {
+                        verify(op);
+                }
+                if (sparse) {
+                        verify_against_dense(dense_op, neighbor_op);
+                        verify_against_dense(dense_op, nbx_op);
+                }
+
+                // Blocking reference and compute kernel of the non-blocking mode
+                double blocking = 0.0;
+                ComputeKernel kernel;
+                if (options.mode == Mode::nonblocking) {
+                        blocking = blocking_baseline(op, options);
+                        kernel = ComputeKernel::calibrate(options.compute > 0.0 ? options.compute : blocking);
+                }
+
+                auto nonblocking_op = [&]
+                {
+                        auto post = [&](MPI_Request *request)
+                        {
+                                if (options.large_count) {
+                                        ialltoallv_c(sbuffer.data(),
+                                                     sendcounts_c.data(),
+                                                     sdispls_c.data(),
+                                                     get_mpi_type(),
+                                                     rbuffer.data(),
+                                                     recvcounts_c.data(),
+                                                     rdispls_c.data(),
+                                                     get_mpi_type(),
+                                                     MPI_COMM_WORLD,
+                                                     request);
+                                } else if (*exchange == Exchange::neighbor) {
+                                        sparse->ineighbor(sbuffer.data(), rbuffer.data(), get_mpi_type(), request);
+                                } else {
+                                        MPI_Ialltoallv(sbuffer.data(),
+                                                       sendcounts.data(),
+                                                       sdispls.data(),
+                                                       get_mpi_type(),
+                                                       rbuffer.data(),
+                                                       recvcounts.data(),
+                                                       rdispls.data(),
+                                                       get_mpi_type(),
+                                                       MPI_COMM_WORLD,
+                                                       request);
+                                }
+                        };
+                        return post_compute_wait(post, kernel, options.timer);
+                };
+
+                // Request of the persistent mode, created once from the same counts and displacements
+                MPI_Request request = MPI_REQUEST_NULL;
+                double init = 0.0;
+                if (options.mode == Mode::persistent) {
+                        init = timed_init([&]
+                        {
+                                if (options.large_count) {
+                                        alltoallv_init_c(sbuffer.data(),
+                                                         sendcounts_c.data(),
+                                                         sdispls_c.data(),
+                                                         get_mpi_type(),
+                                                         rbuffer.data(),
+                                                         recvcounts_c.data(),
+                                                         rdispls_c.data(),
+                                                         get_mpi_type(),
+                                                         MPI_COMM_WORLD,
+                                                         &request);
+                                } else if (*exchange == Exchange::neighbor) {
+                                        sparse->neighbor_init(sbuffer.data(), rbuffer.data(), get_mpi_type(), &request);
+                                } else {
+                                        alltoallv_init(sbuffer.data(),
+                                                       sendcounts.data(),
+                                                       sdispls.data(),
+                                                       get_mpi_type(),
+                                                       rbuffer.data(),
+                                                       recvcounts.data(),
+                                                       rdispls.data(),
+                                                       get_mpi_type(),
+                                                       MPI_COMM_WORLD,
+                                                       &request);
+                                }
+                        }, options.timer);
+                }
+
+                auto persistent_op = [&]
+                {
+                        MPI_Start(&request);
+                        MPI_Wait(&request, MPI_STATUS_IGNORE);
+                };
+
+                auto record = [&](auto &&f)
+                {
+                        if (options.stream) {
+                                stream.open(stream_filename(options.foutput, rank),
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                                measure(f, options, stream, histogram);
+                                stream.finish();
+                        } else {
+                                measure(f, options, times, histogram);
+                        }
+                };
+
+                switch (options.mode) {
+                case Mode::blocking:
+                        record(op);
+                        break;
+                case Mode::nonblocking:
+                        record(nonblocking_op);
+                        break;
+                case Mode::persistent:
+                        record(persistent_op);
+                        MPI_Request_free(&request);
+                        break;
+                }
+
+                const long long iter = static_cast<long long>(histogram.total);
+
+                std::vector<long long> call_times(csize);
+                MPI_Gather(&iter, 1, MPI_LONG_LONG, call_times.data(), 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+                if (rank == 0) {
+                        // @formatter:off
+                        if (!std::ranges::all_of(
+                                call_times.begin(),
+                                call_times.end(),
+                                [&](const long long x)
+                                {
+                                    return x == call_times[0];
+                                })) {
+                                std::cerr << "ERROR: Timing buffers mismatch: "
+                                             "Process has different number of iterations in starts"
+                                          << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                        // @formatter:on
+                }
+
+                // Merge histograms for global percentiles, summarize each rank for local ones
+                report = reduce_latencies(histogram);
+
+                // All pairs with the counts of the matrix
+                const long long out = (std::accumulate(sendcounts_c.begin(), sendcounts_c.end(), 0LL) - sendcounts_c[rank]) * sizeof(T);
+                const long long in = (std::accumulate(recvcounts_c.begin(), recvcounts_c.end(), 0LL) - recvcounts_c[rank]) * sizeof(T);
+                volume = gather_volume(out, in);
+
+                if (rank == 0 && options.verbose) {
+                        const long long msg_size = std::accumulate(sendcounts_c.begin(), sendcounts_c.end(), 0LL);
+                        print_latencies(report, msg_size, iter);
+                        print_volume(volume, report);
+                }
+
+                if (rank == 0 && options.verbose && options.mode == Mode::nonblocking) {
+                        print_overlap(blocking, kernel.seconds, report.global.avg);
+                }
+                if (options.verbose && options.mode == Mode::persistent) {
+                        print_init(init);
+                }
+
+                // Bytes crossing between the lower and the upper half of the ranks, the bisection of
+                // a flat network
+                if (options.verbose) {
+                        long long crossing = 0;
+                        for (int i = 0; i < csize; ++i) {
+                                if ((rank < csize / 2) != (i < csize / 2)) {
+                                        crossing += static_cast<long long>(sendcounts_c[i]) * sizeof(T);
+                                }
+                        }
+
+                        long long bisection = 0;
+                        MPI_Reduce(&crossing, &bisection, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+                        if (rank == 0) {
+                                print_bisection(bisection, report.global.avg);
+                        }
+                }
+
+                // Dense collective against the sparse variants on the same matrix
+                if (options.verbose && sparse) {
+                        const double dense = blocking_baseline(dense_op, options);
+                        const double neighbor = blocking_baseline(neighbor_op, options);
+                        const double nbx = blocking_baseline(nbx_op, options);
+                        if (rank == 0) {
+                                print_sparse(sparse->density, dense, neighbor, nbx);
+                        }
+                }
+
+                MPI_Barrier(MPI_COMM_WORLD);
+        }
+
+        // Save data to file
+        void save_latencies(const Options &options) const
+        {
+                const std::string &filename = options.foutput;
+
+                if (histogram.total == 0) {
+                        std::cerr << "ERROR: Must run first before saving" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                if (options.stream) {
+                        // Timestamps were already written while running
+                        report_stream(stream, options.foutput, options.verbose);
+                        if (rank == 0) {
+                                save_percentiles(filename, report, options.verbose);
+                                save_volume(filename, volume, report, options.verbose);
+                        }
+                        return;
+                }
+
+                switch (options.output_mode) {
+                case OutputMode::csv:
+                        write_csv(filename, times);
+                        break;
+                case OutputMode::parallel_csv:
+                        write_csv_mpiio(filename, times);
+                        break;
+                case OutputMode::parallel_binary:
+                        write_results_mpiio(filename,
+                                            times,
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                        break;
+                }
+
+                if (rank == 0) {
+                        save_percentiles(filename, report, options.verbose);
+                        save_volume(filename, volume, report, options.verbose);
+                }
+
+                if (rank == 0 && options.verbose) {
+                        std::cout << "Latencies saved to " << filename << std::endl;
+                }
+        }
+};
+
+int main(int argc, char *argv[])
+{
+        init_mpi(argc, argv);
+
+        Options options;
+        if (const auto status = parse_options(argc, argv, "alltoallv", options)) {
+                MPI_Finalize();
+                return *status;
+        }
+
+        try {
+                if (options.dtype == "double") {
+                        Alltoallv<double> benchmark(options.fmessages, options.large_count);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else if (options.dtype == "int") {
+                        Alltoallv<int> benchmark(options.fmessages, options.large_count);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else if (options.dtype == "char") {
+                        Alltoallv<char> benchmark(options.fmessages, options.large_count);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else {
+                        std::cerr << "Unknown dtype option: " << options.dtype << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        return EXIT_FAILURE;
+                }
+        } catch (const std::exception &e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                return EXIT_FAILURE;
+        }
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+}
@@ -1,9 +1,7 @@
 #include <algorithm>
-#include <any>
+#include <climits>
 #include <cmath>
-#include <deque>
 #include <fstream>
-#include <getopt.h>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
@@ -13,237 +11,365 @@
 
 #include <mpi.h>
 
+#include "datatypes.hpp"
+#include "matrix.hpp"
+#include "options.hpp"
+#include "output.hpp"
+#include "overlap.hpp"
+#include "persistent.hpp"
+#include "report.hpp"
+#include "stream.hpp"
+#include "timing.hpp"
+#include "volume.hpp"
+
 class Alltoallw {
 
         int rank;
         int csize;
 
-        std::any sbuffer;
-        std::any rbuffer;
-
-        int *displs;
-        int *sendcounts;
-        int *recvcounts;
+        // Per-peer blocks at byte displacements, aligned to DATATYPE_ALIGNMENT
+        std::vector<char> sbuffer;
+        std::vector<char> rbuffer;
 
-        std::deque<double> times{};
+        // Counts in elements of the datatype of the pair
+        std::vector<int> sendcounts;
+        std::vector<int> recvcounts;
+        std::vector<int> sdispls;
+        std::vector<int> rdispls;
         std::vector<MPI_Datatype> sendtypes;
-
-public:
-        explicit Alltoallw(const std::string &filename)
+        std::vector<MPI_Datatype> recvtypes;
+        DatatypeCache datatypes;
+
+        // Same bytes without gaps for the packed MPI_Alltoallv reference, counts and displacements in bytes
+        std::vector<char> spacked;
+        std::vector<char> rpacked;
+        std::vector<int> spacked_counts;
+        std::vector<int> rpacked_counts;
+        std::vector<int> spacked_displs;
+        std::vector<int> rpacked_displs;
+
+        TimestampArena times;
+        StreamWriter stream;
+        LatencyHistogram histogram;
+        LatencyReport report;
+        VolumeReport volume;
+
+        // Datatype description of every pair, row i holds the types rank i sends to each peer. Without
+        // a file rank i sends char, int or double to rank j depending on j % 3.
+        std::vector<std::vector<std::string>> load_types(const std::string &ftypes) const
         {
-                rank = -1;
-                csize = -1;
-
-                sbuffer = nullptr;
-                rbuffer = nullptr;
-                displs = nullptr;
-                sendcounts = nullptr;
-                recvcounts = nullptr;
-
-                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-                MPI_Comm_size(MPI_COMM_WORLD, &csize);
-
-                if (rank == 0 && csize < 2) {
-                        std::cerr << "ERROR: Need more than one process." << std::endl;
-                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                }
-
-                sendtypes.resize(csize, MPI_INT);
-                for (int i = 0; i < csize; ++i) {
-                        switch (i % 3) {
-                        case 0:
-                                sendtypes[i] = MPI_CHAR;
-                                break;
-                        case 1:
-                                sendtypes[i] = MPI_INT;
-                                break;
-                        case 2:
-                                sendtypes[i] = MPI_DOUBLE;
-                                break;
-                        default:
-                                sendtypes[i] = MPI_INT;
-                                break;
+                std::vector specs(csize, std::vector<std::string>(csize));
+                if (ftypes.empty()) {
+                        const std::string base[] = {"char", "int", "double"};
+                        for (int i = 0; i < csize; ++i) {
+                                for (int j = 0; j < csize; ++j) {
+                                        specs[i][j] = base[j % 3];
+                                }
                         }
+                        return specs;
                 }
 
-                sendcounts = new int[csize];
-                recvcounts = new int[csize];
+                // Root reads the file and every process parses all of it
+                std::string content;
                 if (rank == 0) {
-                        std::vector rows(csize, std::vector<int>(csize));
-                        std::vector columns(csize, std::vector<int>(csize));
-
-                        std::ifstream file(filename);
+                        std::ifstream file(ftypes);
                         if (!file) {
-                                std::cerr << "ERROR: Could not open file " << filename << std::endl;
+                                std::cerr << "ERROR: Could not open file " << ftypes << std::endl;
                                 MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                         }
-
-                        size_t prc = 0;
-                        std::string line;
-                        while (std::getline(file, line)) {
-                                std::istringstream ss(line);
-                                std::vector row(csize, 0);
-                                std::string val;
-
-                                size_t idx = 0;
-                                while (std::getline(ss, val, ',')) {
-                                        row[idx] = std::stoi(val);
-                                        idx++;
-                                        if (idx > csize) {
-                                                // @formatter:off
-                                                std::cerr << "ERROR: Number of columns "
-                                                          << "(" << idx << ") "
-                                                          << "does not match number of processes "
-                                                          << "(" << csize << ")."
-                                                          << std::endl;
-                                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                                                // @formatter:on
-                                        }
-                                }
-
-                                if (idx < csize) {
-                                        // @formatter:off
-                                        std::cerr << "ERROR: Number of columns "
-                                                  << "(" << idx << ") "
-                                                  << "does not match number of processes "
-                                                  << "(" << csize << ")."
-                                                  << std::endl;
-                                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                                        // @formatter:on
-                                }
-
-                                rows[prc] = row;
-                                for (size_t i = 0; i < csize; ++i) {
-                                        columns[i][prc] = row[i];
-                                }
-
-                                prc++;
-                                if (prc > csize) {
-                                        std::cerr << "ERROR: Too many lines in file " << std::endl;
-                                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                }
+                int length = static_cast<int>(content.size());
+                MPI_Bcast(&length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                content.resize(length);
+                MPI_Bcast(content.data(), length, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+                std::istringstream lines(content);
+                std::string line;
+                int prc = 0;
+                while (std::getline(lines, line)) {
+                        if (trim(line).empty()) {
+                                continue;
+                        }
+                        if (prc >= csize) {
+                                std::cerr << "ERROR: Too many lines in file " << ftypes << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                        std::istringstream ss(line);
+                        int idx = 0;
+                        std::string spec;
+                        while (ss >> spec) {
+                                if (idx >= csize) {
+                                        break;
                                 }
+                                specs[prc][idx++] = spec;
                         }
-
-                        if (prc != csize) {
-                                std::cerr << "ERROR: Not enough lines in file " << std::endl;
+                        if (idx != csize || ss >> spec) {
+                                // @formatter:off
+                                std::cerr << "ERROR: Number of datatypes in line " << prc + 1 << " of " << ftypes
+                                          << " does not match number of processes "
+                                          << "(" << csize << ")."
+                                          << std::endl;
                                 MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                                // @formatter:on
                         }
+                        prc++;
+                }
+                if (prc != csize) {
+                        std::cerr << "ERROR: Not enough lines in file " << ftypes << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                return specs;
+        }
 
-                        file.close();
-
-                        for (int i = 0; i < csize; ++i) {
-                                MPI_Send(rows[i].data(), csize, MPI_INT, i, 0, MPI_COMM_WORLD);
-                                MPI_Send(columns[i].data(), csize, MPI_INT, i, 0, MPI_COMM_WORLD);
+        // Byte displacement of every block for counts elements of types, returns the buffer size
+        static size_t layout(const std::vector<int> &counts, const std::vector<MPI_Datatype> &types, std::vector<int> &displs)
+        {
+                MPI_Aint offset = 0;
+                displs.resize(counts.size());
+                for (size_t i = 0; i < counts.size(); ++i) {
+                        MPI_Aint lb, extent;
+                        MPI_Type_get_extent(types[i], &lb, &extent);
+                        offset = round_up(offset, DATATYPE_ALIGNMENT);
+                        if (offset > INT_MAX) {
+                                std::cerr << "ERROR: Displacements exceed the range of int" << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                         }
+                        displs[i] = static_cast<int>(offset);
+                        offset += counts[i] * extent;
+                }
+                return static_cast<size_t>(std::max<MPI_Aint>(offset, 1));
+        }
 
-                } else {
-                        std::vector<int> sendcounts_vec(csize);
-                        std::vector<int> recvcounts_vec(csize);
-                        MPI_Recv(sendcounts_vec.data(), csize, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                        MPI_Recv(recvcounts_vec.data(), csize, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                        for (int i = 0; i < csize; ++i) {
-                                sendcounts[i] = sendcounts_vec[i];
-                        }
-                        for (int i = 0; i < csize; ++i) {
-                                recvcounts[i] = recvcounts_vec[i];
+        // Bytes of the data only, without gaps, as MPI_Pack produces them on homogeneous systems
+        static size_t packed_layout(const std::vector<int> &counts,
+                                    const std::vector<MPI_Datatype> &types,
+                                    std::vector<int> &packed_counts,
+                                    std::vector<int> &packed_displs)
+        {
+                size_t offset = 0;
+                packed_counts.resize(counts.size());
+                packed_displs.resize(counts.size());
+                for (size_t i = 0; i < counts.size(); ++i) {
+                        int size;
+                        MPI_Type_size(types[i], &size);
+                        const long long bytes = static_cast<long long>(counts[i]) * size;
+                        if (offset + bytes > INT_MAX) {
+                                std::cerr << "ERROR: Packed displacements exceed the range of int" << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                         }
+                        packed_counts[i] = static_cast<int>(bytes);
+                        packed_displs[i] = static_cast<int>(offset);
+                        offset += packed_counts[i];
                 }
+                return std::max<size_t>(offset, 1);
+        }
 
-                int ssize = 0;
-                for (int i = 0; i < csize; ++i) {
-                        ssize += sendcounts[i];
+        // Write value(i) into every byte of the type map of block i through its datatype, the gaps
+        // between the members keep their contents
+        template <typename V>
+        static void fill_blocks(std::vector<char> &buffer,
+                                const std::vector<int> &counts,
+                                const std::vector<int> &displs,
+                                const std::vector<MPI_Datatype> &types,
+                                V &&value)
+        {
+                for (size_t i = 0; i < counts.size(); ++i) {
+                        int size;
+                        MPI_Pack_size(counts[i], types[i], MPI_COMM_WORLD, &size);
+                        const std::vector<char> packed(size, value(static_cast<int>(i)));
+                        int position = 0;
+                        MPI_Unpack(packed.data(), size, &position, buffer.data() + displs[i], counts[i], types[i], MPI_COMM_WORLD);
                 }
-                // TODO Setup sbuffer
-                switch (rank % 3) {
-                case 0:
-                        sbuffer = new char[ssize];
-                        // auto carr = std::any_cast<char *>(sbuffer);
-                        // for (int i = 0; i < ssize; ++i) {
-                        //         carr[i] = static_cast<char>(rank);
-                        // }
-                        break;
+        }
 
-                case 1:
-                        sbuffer = new int[ssize];
-                        // auto iarr = std::any_cast<int *>(sbuffer);
-                        // for (int i = 0; i < ssize; ++i) {
-                        //         iarr[i] = rank;
-                        // }
-                        break;
-                case 2:
-                        sbuffer = new double[ssize];
-                        // auto darr = std::any_cast<int *>(sbuffer);
-                        // for (int i = 0; i < ssize; ++i) {
-                        //         darr[i] = static_cast<double>(rank);
-                        // }
-                        break;
-                default:
-                        std::cerr << "ERROR: Rank unitialized" << std::endl;
+        // Send the rank through every send datatype and run op once on a cleared receive buffer. Block i
+        // has to hold the value i in the type map of the pair and keep the sentinel in its gaps.
+        template <typename F>
+        void verify(F &&op)
+        {
+                fill_blocks(sbuffer, sendcounts, sdispls, sendtypes, [&](int) { return static_cast<char>(rank); });
+                std::vector<char> expected(rbuffer.size(), static_cast<char>(csize));
+                fill_blocks(expected, recvcounts, rdispls, recvtypes, [](const int i) { return static_cast<char>(i); });
+                std::ranges::fill(rbuffer, static_cast<char>(csize));
+                op();
+
+                bool valid = rbuffer == expected;
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Received payload does not match the send buffers" << std::endl;
+                        }
                         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                        break;
                 }
+        }
 
-                // TODO Setup rbuffer
+        static void print_packed(const double typed, const double packed, const double pack)
+        {
+                // @formatter:off
+                std::ostringstream oss;
+                oss << std::left << std::setw(25) << "Alltoallw (μs)"
+                                 << std::setw(25) << "Packed Alltoallv (μs)"
+                                 << std::setw(25) << "Pack+Alltoallv (μs)"
+                                 << std::setw(25) << "Type Overhead (%)"
+                                 << std::endl
+                                 << std::setw(25) << typed * 1e6
+                                 << std::setw(25) << packed * 1e6
+                                 << std::setw(25) << pack * 1e6
+                                 << std::setw(25) << (packed > 0.0 ? (typed / packed - 1.0) * 100.0 : 0.0)
+                                 << std::endl;
+                std::cout << oss.str() << std::endl;
+                // @formatter:on
+        }
+
+public:
+        Alltoallw(const std::string &filename, const std::string &ftypes)
+        {
+                rank = -1;
+                csize = -1;
 
-                displs = new int[csize];
-                displs[0] = 0;
-                for (int i = 1; i < csize; ++i) {
-                        displs[i] = displs[i - 1] + sendcounts[i - 1];
+                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+
+                if (rank == 0 && csize < 2) {
+                        std::cerr << "ERROR: Need more than one process." << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
 
+                std::vector<long long> scounts, rcounts;
+                load_m2m(filename, scounts, rcounts);
+                if (std::ranges::max(scounts) > INT_MAX || std::ranges::max(rcounts) > INT_MAX) {
+                        std::cerr << "ERROR: Counts exceed the range of int, alltoallw has no large-count variant" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                sendcounts.assign(scounts.begin(), scounts.end());
+                recvcounts.assign(rcounts.begin(), rcounts.end());
+
+                // Sender and receiver of a pair use the same datatype, so type signatures match
+                const std::vector<std::vector<std::string>> specs = load_types(ftypes);
+                sendtypes.resize(csize);
+                recvtypes.resize(csize);
+                for (int i = 0; i < csize; ++i) {
+                        sendtypes[i] = datatypes.get(specs[rank][i]);
+                        recvtypes[i] = datatypes.get(specs[i][rank]);
+                }
+
+                sbuffer.assign(layout(sendcounts, sendtypes, sdispls), static_cast<char>(rank));
+                rbuffer.assign(layout(recvcounts, recvtypes, rdispls), 0);
+                spacked.assign(packed_layout(sendcounts, sendtypes, spacked_counts, spacked_displs), 0);
+                rpacked.assign(packed_layout(recvcounts, recvtypes, rpacked_counts, rpacked_displs), 0);
+
                 MPI_Barrier(MPI_COMM_WORLD);
         }
 
-        void run(const double max_seconds = 1, const bool verbose = false)
+        void run(const Options &options)
         {
-                // Global clock
-                double global_start_time = 0.0;
-                if (rank == 0) {
-                        global_start_time = MPI_Wtime();
-                }
-                MPI_Bcast(&global_start_time, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-                while (true) {
-                        const double t_start = MPI_Wtime();
-                        // TODO Setup appropriate funciton call
-                        /*
-                        MPI_Alltoallw(sbuffer,
-                                      sendcounts,
-                                      displs,
-                                      sendtypes,
-                                      rbuffer,
-                                      recvcounts,
-                                      displs,
-                                      sendtypes,
+                auto op = [&]
+                {
+                        MPI_Alltoallw(sbuffer.data(),
+                                      sendcounts.data(),
+                                      sdispls.data(),
+                                      sendtypes.data(),
+                                      rbuffer.data(),
+                                      recvcounts.data(),
+                                      rdispls.data(),
+                                      recvtypes.data(),
                                       MPI_COMM_WORLD);
-                        */
-                        const double t_stop = MPI_Wtime();
+                };
 
-                        times.push_back(t_start);
-                        times.push_back(t_stop);
+                // Check the payload once, outside of the timed iterations
+                verify(op);
 
-                        bool continue_loop = true;
-                        if (rank == 0) {
-                                const double elapsed_time = MPI_Wtime() - global_start_time;
-                                continue_loop = elapsed_time < max_seconds;
+                // Blocking reference and compute kernel of the non-blocking mode
+                double blocking = 0.0;
+                ComputeKernel kernel;
+                if (options.mode == Mode::nonblocking) {
+                        blocking = blocking_baseline(op, options);
+                        kernel = ComputeKernel::calibrate(options.compute > 0.0 ? options.compute : blocking);
+                }
+
+                auto nonblocking_op = [&]
+                {
+                        auto post = [&](MPI_Request *request)
+                        {
+                                MPI_Ialltoallw(sbuffer.data(),
+                                               sendcounts.data(),
+                                               sdispls.data(),
+                                               sendtypes.data(),
+                                               rbuffer.data(),
+                                               recvcounts.data(),
+                                               rdispls.data(),
+                                               recvtypes.data(),
+                                               MPI_COMM_WORLD,
+                                               request);
+                        };
+                        return post_compute_wait(post, kernel, options.timer);
+                };
+
+                // Request of the persistent mode, created once from the same counts and displacements
+                MPI_Request request = MPI_REQUEST_NULL;
+                double init = 0.0;
+                if (options.mode == Mode::persistent) {
+                        init = timed_init([&]
+                        {
+                                alltoallw_init(sbuffer.data(),
+                                               sendcounts.data(),
+                                               sdispls.data(),
+                                               sendtypes.data(),
+                                               rbuffer.data(),
+                                               recvcounts.data(),
+                                               rdispls.data(),
+                                               recvtypes.data(),
+                                               MPI_COMM_WORLD,
+                                               &request);
+                        }, options.timer);
+                }
+
+                auto persistent_op = [&]
+                {
+                        MPI_Start(&request);
+                        MPI_Wait(&request, MPI_STATUS_IGNORE);
+                };
+
+                auto record = [&](auto &&f)
+                {
+                        if (options.stream) {
+                                stream.open(stream_filename(options.foutput, rank),
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                                measure(f, options, stream, histogram);
+                                stream.finish();
+                        } else {
+                                measure(f, options, times, histogram);
                         }
-                        MPI_Bcast(&continue_loop, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-                        if (!continue_loop)
-                                break;
+                };
+
+                switch (options.mode) {
+                case Mode::blocking:
+                        record(op);
+                        break;
+                case Mode::nonblocking:
+                        record(nonblocking_op);
+                        break;
+                case Mode::persistent:
+                        record(persistent_op);
+                        MPI_Request_free(&request);
+                        break;
                 }
-                MPI_Barrier(MPI_COMM_WORLD);
 
-                const int iter = static_cast<int>(times.size()) / 2;
+                const long long iter = static_cast<long long>(histogram.total);
 
-                std::vector<int> call_times(csize);
-                MPI_Gather(&iter, 1, MPI_INT, call_times.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+                std::vector<long long> call_times(csize);
+                MPI_Gather(&iter, 1, MPI_LONG_LONG, call_times.data(), 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
 
                 if (rank == 0) {
                         // @formatter:off
                         if (!std::ranges::all_of(
                                 call_times.begin(),
                                 call_times.end(),
-                                [&](const int x)
+                                [&](const long long x)
                                 {
                                     return x == call_times[0];
                                 })) {
@@ -255,143 +381,123 @@ public:
                         // @formatter:on
                 }
 
-                std::vector<double> lat(iter);
-                for (int i = 0; i <= iter; ++i) {
-                        lat[i] = times[i + 1] - times[i];
-                }
-
-                double min_local = *std::ranges::min_element(lat);
-                double max_local = *std::ranges::max_element(lat);
-                double avg_local = std::accumulate(lat.begin(), lat.end(), 0.0) / iter;
-
-                std::vector<double> min_locals(csize);
-                std::vector<double> max_locals(csize);
-                std::vector<double> avg_locals(csize);
+                // Merge histograms for global percentiles, summarize each rank for local ones
+                report = reduce_latencies(histogram);
 
-                // Perform the reduction to gather global min, max, and average
-                MPI_Gather(&min_local, 1, MPI_DOUBLE, min_locals.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&max_local, 1, MPI_DOUBLE, max_locals.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&avg_local, 1, MPI_DOUBLE, avg_locals.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                // All pairs, the packed counts are the bytes of the datatypes of every pair
+                const long long out = std::accumulate(spacked_counts.begin(), spacked_counts.end(), 0LL) - spacked_counts[rank];
+                const long long in = std::accumulate(rpacked_counts.begin(), rpacked_counts.end(), 0LL) - rpacked_counts[rank];
+                volume = gather_volume(out, in);
 
-                if (rank == 0 && verbose) {
-                        // Output local
-                        // @formatter:off
-                        std::ostringstream oss1;
-                        oss1 << std::left << std::setw(25) << ""
-                                         << std::setw(25) << "Avg Latency (μs)"
-                                         << std::setw(25) << "Min Latency (μs)"
-                                         << std::setw(25) << "Max Latency (μs)"
-                                         << std::endl;
+                if (rank == 0 && options.verbose) {
+                        long long msg_size = 0;
                         for (int i = 0; i < csize; ++i) {
-                                oss1 << std::left << std::setw(25) << "Rank " + std::to_string(i)
-                                                 << std::setw(25) << avg_locals[i] * 1e6
-                                                 << std::setw(25) << min_locals[i] * 1e6
-                                                 << std::setw(25) << max_locals[i] * 1e6
-                                                 << std::endl;
+                                msg_size += sendcounts[i];
                         }
-                        std::cout << oss1.str() << std::endl;
-                        // @formatter:on
+                        print_latencies(report, msg_size, iter);
+                        print_volume(volume, report);
+                }
 
-                        // Compute global min, max, average by iteration over all processes
-                        double min_global = *std::ranges::min_element(min_locals);
-                        double max_global = *std::ranges::max_element(max_locals);
-                        double avg_global = std::accumulate(avg_locals.begin(), avg_locals.end(), 0.0) / csize;
+                if (rank == 0 && options.verbose && options.mode == Mode::nonblocking) {
+                        print_overlap(blocking, kernel.seconds, report.global.avg);
+                }
+                if (options.verbose && options.mode == Mode::persistent) {
+                        print_init(init);
+                }
 
-                        int msg_size = 0;
-                        for (int i = 0; i < csize; ++i) {
-                                msg_size += sendcounts[i];
-                        }
-                        // @formatter:off
-                        std::ostringstream oss2;
-                        oss2 << std::left << std::setw(25) << "Global messages count"
-                                         << std::setw(25) << "Avg Latency (μs)"
-                                         << std::setw(25) << "Min Latency (μs)"
-                                         << std::setw(25) << "Max Latency (μs)"
-                                         << std::setw(25) << "Iterations"
-                                         << std::endl
-                                         << std::setw(25) << msg_size
-                                         << std::setw(25) << avg_global * 1e6
-                                         << std::setw(25) << min_global * 1e6
-                                         << std::setw(25) << max_global * 1e6
-                                         << std::setw(25) << iter
-                                         << std::endl
-                                         << std::endl;
-                        std::cout << oss2.str() << std::endl;
-                        // @formatter:on
+                // Cost of the type heterogeneity against the same bytes in a packed MPI_Alltoallv
+                if (options.verbose) {
+                        auto packed_op = [&]
+                        {
+                                MPI_Alltoallv(spacked.data(),
+                                              spacked_counts.data(),
+                                              spacked_displs.data(),
+                                              MPI_BYTE,
+                                              rpacked.data(),
+                                              rpacked_counts.data(),
+                                              rpacked_displs.data(),
+                                              MPI_BYTE,
+                                              MPI_COMM_WORLD);
+                        };
+                        auto pack_op = [&]
+                        {
+                                for (int i = 0; i < csize; ++i) {
+                                        int position = spacked_displs[i];
+                                        MPI_Pack(sbuffer.data() + sdispls[i],
+                                                 sendcounts[i],
+                                                 sendtypes[i],
+                                                 spacked.data(),
+                                                 static_cast<int>(spacked.size()),
+                                                 &position,
+                                                 MPI_COMM_WORLD);
+                                }
+                                packed_op();
+                                for (int i = 0; i < csize; ++i) {
+                                        int position = rpacked_displs[i];
+                                        MPI_Unpack(rpacked.data(),
+                                                   static_cast<int>(rpacked.size()),
+                                                   &position,
+                                                   rbuffer.data() + rdispls[i],
+                                                   recvcounts[i],
+                                                   recvtypes[i],
+                                                   MPI_COMM_WORLD);
+                                }
+                        };
 
+                        const double typed = blocking_baseline(op, options);
+                        const double packed = blocking_baseline(packed_op, options);
+                        const double pack = blocking_baseline(pack_op, options);
+                        if (rank == 0) {
+                                print_packed(typed, packed, pack);
+                        }
                 }
 
                 MPI_Barrier(MPI_COMM_WORLD);
         }
 
         // Save data to file
-        void save_latencies(const std::string &filename, const bool verbose = false) const
+        void save_latencies(const Options &options) const
         {
-                if (times.empty()) {
+                const std::string &filename = options.foutput;
+
+                if (histogram.total == 0) {
                         std::cerr << "ERROR: Must run first before saving" << std::endl;
                         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
 
-                const int iter = static_cast<int>(times.size()) / 2;
-
-                if (rank == 0) {
-                        std::ofstream out_file(filename);
-                        if (!out_file) {
-                                std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
-                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                if (options.stream) {
+                        // Timestamps were already written while running
+                        report_stream(stream, options.foutput, options.verbose);
+                        if (rank == 0) {
+                                save_percentiles(filename, report, options.verbose);
+                                save_volume(filename, volume, report, options.verbose);
                         }
+                        return;
+                }
 
-                        out_file.seekp(0, std::ios::end);
-                        if (out_file.tellp() == 0) {
-                                out_file << "Rank,Iteration,Starttime,Endtime\n";
-                                out_file.flush();
-                        }
-                        for (int i = 0; i < iter; ++i) {
-                                out_file << rank << ","
-                                                << i << ","
-                                                << std::fixed << std::setprecision(8) << times[i] << ","
-                                                << std::fixed << std::setprecision(8) << times[i + 1] << "\n";
-                        }
-                        out_file.close();
-                } else {
-                        // Needs to be contiguous memory block
-                        std::vector<double> vec_times(times.size());
-                        for (int i = 0; i < times.size(); ++i) {
-                                vec_times[i] = times[i];
-                        }
-                        MPI_Send(vec_times.data(), times.size(), MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+                switch (options.output_mode) {
+                case OutputMode::csv:
+                        write_csv(filename, times);
+                        break;
+                case OutputMode::parallel_csv:
+                        write_csv_mpiio(filename, times);
+                        break;
+                case OutputMode::parallel_binary:
+                        write_results_mpiio(filename,
+                                            times,
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                        break;
                 }
 
                 if (rank == 0) {
-                        std::ofstream out_file(filename, std::ios::app);
-                        if (!out_file) {
-                                std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
-                                exit(EXIT_FAILURE);
-                        }
-
-                        for (int r = 1; r < csize; ++r) {
-                                std::vector<double> recv_vec_times(times.size());
-                                MPI_Recv(recv_vec_times.data(),
-                                         times.size(),
-                                         MPI_DOUBLE,
-                                         r,
-                                         0,
-                                         MPI_COMM_WORLD,
-                                         MPI_STATUS_IGNORE);
-
-                                for (int i = 0; i < iter; ++i) {
-                                        out_file << r << ","
-                                                        << i << ","
-                                                        << std::fixed << std::setprecision(8) << recv_vec_times[i] <<
-                                                        ","
-                                                        << std::fixed << std::setprecision(8) << recv_vec_times[i + 1]
-                                                        << "\n";
-                                }
-                        }
-                        out_file.close();
+                        save_percentiles(filename, report, options.verbose);
+                        save_volume(filename, volume, report, options.verbose);
                 }
 
-                if (rank == 0 && verbose) {
+                if (rank == 0 && options.verbose) {
                         std::cout << "Latencies saved to " << filename << std::endl;
                 }
         }
@@ -399,64 +505,18 @@ public:
 
 int main(int argc, char *argv[])
 {
-        int rank;
-        MPI_Init(&argc, &argv);
-        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-        const option long_options[] = {
-                        {"help", no_argument, nullptr, 'h'},
-                        {"fmessages", required_argument, nullptr, 'm'},
-                        {"foutput", required_argument, nullptr, 'o'},
-                        {"timeout", required_argument, nullptr, 't'},
-                        {"verbose", no_argument, nullptr, 'v'},
-                        {nullptr, 0, nullptr, 0}
-        };
-
-        std::string fmessages = "default_messages.txt";
-        std::string foutput = "default_output.txt";
-        int timeout = 10;
-        bool verbose = false;
-
-        int opt;
-
-        while ((opt = getopt_long(argc, argv, "hm:o:n:t:v", long_options, nullptr)) != -1) {
-                switch (opt) {
-                case 'h':
-                        // @formatter:off
-                        if (rank == 0) {
-                                std::cout << "Help: This program runs a MPI alltoallw\n"
-                                                << "Options:\n"
-                                                << "  -h, --help            Show this help message\n"
-                                                << "  -m, --fmessages FILE  Specify file with messages (default: default_messages.txt)\n"
-                                                << "  -o, --foutput FILE    Specify output file (default: default_output.txt)\n"
-                                                << "  -t, --timeout NUM     Specify timeout value in seconds (default: 10)\n"
-                                                << "  -v, --verbose         Enable verbose mode\n";
-                        }
-                        // @formatter:on
-                        return EXIT_SUCCESS;
-                case 'm':
-                        fmessages = optarg;
-                        break;
-                case 'o':
-                        foutput = optarg;
-                        break;
-                case 'v':
-                        verbose = true;
-                        break;
-                case 't':
-                        timeout = std::stoi(optarg);
-                        break;
-                default:
-                        std::cerr << "Unknown option\n";
-                        std::cerr << optarg << std::endl;
-                        return EXIT_FAILURE;
-                }
+        init_mpi(argc, argv);
+
+        Options options;
+        if (const auto status = parse_options(argc, argv, "alltoallw", options)) {
+                MPI_Finalize();
+                return *status;
         }
 
         try {
-                Alltoallw benchmark(fmessages);
-                benchmark.run(timeout, verbose);
-                benchmark.save_latencies(foutput, verbose);
+                Alltoallw benchmark(options.fmessages, options.ftypes);
+                benchmark.run(options);
+                benchmark.save_latencies(options);
         } catch (const std::exception &e) {
                 std::cerr << "ERROR: " << e.what() << std::endl;
                 MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
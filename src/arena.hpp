@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <mpi.h>
+
+#include "clocksync.hpp"
+
+// Arenas from this size on are backed by transparent huge pages if available
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Fixed-capacity store of start and stop timestamps. Memory is mapped and prefaulted up front
+// so that recording a sample never touches the allocator or takes a page fault. Samples are
+// stored interleaved as start0, stop0, start1, stop1, ... and can be passed to MPI as is.
+class TimestampArena {
+        double *buffer = nullptr;
+        size_t bytes = 0;
+        size_t capacity = 0;
+        size_t samples = 0;
+
+        void release()
+        {
+                if (buffer != nullptr) {
+                        munmap(buffer, bytes);
+                }
+                buffer = nullptr;
+                bytes = 0;
+                capacity = 0;
+                samples = 0;
+        }
+
+public:
+        TimestampArena() = default;
+        TimestampArena(const TimestampArena &) = delete;
+        TimestampArena &operator=(const TimestampArena &) = delete;
+
+        ~TimestampArena()
+        {
+                release();
+        }
+
+        // Map and prefault room for n samples, drops previously recorded samples
+        void reserve(const size_t n)
+        {
+                release();
+
+                const size_t page = sysconf(_SC_PAGESIZE);
+                bytes = std::max<size_t>(2 * n * sizeof(double), 1);
+                bytes = (bytes + page - 1) / page * page;
+
+                void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (ptr == MAP_FAILED) {
+                        std::cerr << "ERROR: Could not map " << bytes << " bytes for timestamps" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+#ifdef MADV_HUGEPAGE
+                if (bytes >= HUGE_PAGE_SIZE) {
+                        // Best effort, falls back to regular pages
+                        madvise(ptr, bytes, MADV_HUGEPAGE);
+                }
+#endif
+                // Prefault every page before the first iteration
+                auto *bytes_ptr = static_cast<volatile char *>(ptr);
+                for (size_t i = 0; i < bytes; i += page) {
+                        bytes_ptr[i] = 0;
+                }
+
+                buffer = static_cast<double *>(ptr);
+                capacity = n;
+        }
+
+        void record(const double t_start, const double t_stop) noexcept
+        {
+                buffer[2 * samples] = t_start;
+                buffer[2 * samples + 1] = t_stop;
+                ++samples;
+        }
+
+        [[nodiscard]] bool full() const noexcept
+        {
+                return samples >= capacity;
+        }
+
+        [[nodiscard]] bool empty() const noexcept
+        {
+                return samples == 0;
+        }
+
+        // Number of recorded samples
+        [[nodiscard]] size_t size() const noexcept
+        {
+                return samples;
+        }
+
+        [[nodiscard]] double start(const size_t i) const noexcept
+        {
+                return buffer[2 * i];
+        }
+
+        [[nodiscard]] double stop(const size_t i) const noexcept
+        {
+                return buffer[2 * i + 1];
+        }
+
+        [[nodiscard]] double latency(const size_t i) const noexcept
+        {
+                return buffer[2 * i + 1] - buffer[2 * i];
+        }
+
+        // Map every recorded timestamp to the clock of rank 0
+        void apply_clock(const ClockModel &clock) noexcept
+        {
+                for (size_t i = 0; i < 2 * samples; ++i) {
+                        buffer[i] = clock.to_global(buffer[i]);
+                }
+        }
+
+        // Interleaved timestamps, 2 * size() values
+        [[nodiscard]] const double *data() const noexcept
+        {
+                return buffer;
+        }
+};
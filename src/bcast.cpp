@@ -2,23 +2,35 @@
 #include <chrono>
 #include <cmath>
 #include <fstream>
-#include <getopt.h>
 #include <iostream>
 #include <numeric>
+#include <sstream>
+#include <string>
 #include <vector>
 #include <iomanip>
 
 
 #include <mpi.h>
 
-// TODO Maybe other mod. Needed though, otherwise filesize issues
-constexpr int TIMINGS_GRANULARITY = 100;
+#include "algorithms.hpp"
+#include "matrix.hpp"
+#include "options.hpp"
+#include "timing.hpp"
+
+// One point of the latency/bandwidth curve, latencies are the average of every process in seconds
+struct CurvePoint {
+        std::string algorithm;
+        size_t bytes;
+        double avg;
+        double min;
+        double max;
+};
 
 class Bcast {
         int rank{};
         int csize{};
         std::vector<double> buffer;
-        std::vector<double> timings;
+        std::vector<CurvePoint> curve;
 
         // Prepare messages
         void setup(const size_t msg_size)
@@ -32,44 +44,49 @@ class Bcast {
                 }
         }
 
-public:
-        Bcast()
+        // Broadcast a known pattern once, outside of the timed iterations, and check it everywhere
+        void verify(BcastSchedule &schedule, const int msg_size)
         {
-                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+                for (int i = 0; i < msg_size; ++i) {
+                        buffer[i] = rank == 0 ? static_cast<double>(i + 1) : 0.0;
+                }
+                schedule.run(buffer.data());
 
-                if (rank == 0 && csize < 2) {
-                        std::cerr << "ERROR: Need more than one process." << std::endl;
-                        MPI_Finalize();
-                        std::exit(EXIT_FAILURE);
+                bool valid = true;
+                for (int i = 0; i < msg_size; ++i) {
+                        valid = valid && buffer[i] == static_cast<double>(i + 1);
+                }
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Received payload does not match the root's buffer" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
         }
 
-        void run(const size_t msg_size, const double max_seconds = 1, const bool verbose = false)
+        void run_size(const std::string &algorithm,
+                      const int msg_size,
+                      const Timer &clock,
+                      const double max_seconds,
+                      const bool verbose)
         {
-                setup(msg_size);
-                int msg_size_int;
-                if (msg_size <= static_cast<size_t>(std::numeric_limits<int>::max())) {
-                        msg_size_int = static_cast<int>(msg_size);
-                } else {
-                        msg_size_int = std::numeric_limits<int>::max();
-                }
-
-                if (rank == 0 && verbose) {
-                        // @formatter:off
-                        std::cout << std::left
-                                        << std::setw(25) << "Size (Bytes)"
-                                        << std::setw(25) << "Avg Latency (μs)"
-                                        << std::setw(25) << "Min Latency (μs)"
-                                        << std::setw(25) << "Max Latency (μs)"
-                                        << std::endl;
-                        // @formatter:on
-                }
+                BcastSchedule schedule(*parse_bcast_algorithm(algorithm), msg_size, MPI_DOUBLE);
+                verify(schedule, msg_size);
 
                 double timer = 0.0;
                 double latency = 0.0;
                 double min_time = 0.0, max_time = 0.0, avg_time = 0.0;
-                int iter = 0;
+                long long iter = 0;
+
+                const long long iterations = calibrate_iterations(
+                        [&]
+                        {
+                                schedule.run(buffer.data());
+                                MPI_Barrier(MPI_COMM_WORLD);
+                        },
+                        max_seconds);
+                const long long batch = std::max(1LL, iterations / BUDGET_CHECKS);
 
                 // Global clock
                 double global_start_time = 0.0;
@@ -78,32 +95,24 @@ public:
                 }
                 MPI_Bcast(&global_start_time, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-                // Time-based measurement
-                while (true) {
-                        const double t_start = MPI_Wtime();
-                        MPI_Bcast(buffer.data(), msg_size_int, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                        const double t_stop = MPI_Wtime();
+                // Calibrated number of iterations, time budget is only checked per batch
+                while (iter < iterations) {
+                        const double t_start = clock.start();
+                        schedule.run(buffer.data());
+                        const double t_stop = clock.stop();
 
-                        timer += t_stop - t_start;
+                        timer += std::max(t_stop - t_start - clock.overhead, 0.0);
                         iter++;
-                        if (iter % TIMINGS_GRANULARITY == 0) {
-                                timings.push_back(timer);
-                        }
                         MPI_Barrier(MPI_COMM_WORLD);
 
-                        bool continue_loop = true;
-                        if (rank == 0) {
-                                const double elapsed_time = MPI_Wtime() - global_start_time;
-                                continue_loop = elapsed_time < max_seconds;
-                        }
-                        MPI_Bcast(&continue_loop, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-                        if (!continue_loop)
+                        if (iter % batch == 0 && iter < iterations &&
+                            budget_exceeded(global_start_time, max_seconds)) {
                                 break;
+                        }
                 }
                 MPI_Barrier(MPI_COMM_WORLD);
 
-                // Calculate latency in microseconds
-                latency = (timer * 1e6) / iter;
+                latency = timer / iter;
 
                 // Reduce operations to get min, max, and average times
                 MPI_Reduce(&latency, &min_time, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
@@ -112,67 +121,96 @@ public:
                 MPI_Reduce(&latency, &avg_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
                 avg_time /= csize;
 
+                const size_t bytes = msg_size * sizeof(double);
+                curve.push_back({algorithm, bytes, avg_time, min_time, max_time});
+
                 if (rank == 0 && verbose) {
                         // @formatter:off
                         std::cout << std::left
-                                  << std::setw(25) << msg_size
-                                  << std::setw(25) << avg_time
-                                  << std::setw(25) << min_time
-                                  << std::setw(25) << max_time
+                                  << std::setw(25) << algorithm
+                                  << std::setw(25) << bytes
+                                  << std::setw(25) << avg_time * 1e6
+                                  << std::setw(25) << min_time * 1e6
+                                  << std::setw(25) << max_time * 1e6
+                                  << std::setw(25) << (avg_time > 0.0 ? static_cast<double>(bytes) / avg_time * 1e-6 : 0.0)
                                   << std::endl;
                         // @formatter:on
                 }
+        }
 
+public:
+        Bcast()
+        {
+                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+
+                if (rank == 0 && csize < 2) {
+                        std::cerr << "ERROR: Need more than one process." << std::endl;
+                        MPI_Finalize();
+                        std::exit(EXIT_FAILURE);
+                }
         }
 
-        // Save data to file
-        void save_latencies(const std::string &filename, const bool verbose = false) const
+        // Sweep powers of two from 1 element up to the largest count in the message file, for one
+        // algorithm or for all of them, with an equal share of the time budget per size
+        void run(const Options &options)
         {
-                int num_timings;
-                if (timings.size() <= static_cast<size_t>(std::numeric_limits<int>::max())) {
-                        num_timings = static_cast<int>(timings.size());
-                } else {
-                        num_timings = std::numeric_limits<int>::max();
+                std::vector<std::string> algorithms = {options.algorithm.empty() ? "library" : options.algorithm};
+                if (options.algorithm == "all") {
+                        algorithms = {"library", "binomial", "chain", "scatter-allgather"};
+                } else if (!parse_bcast_algorithm(options.algorithm)) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Unknown algorithm " << options.algorithm << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
 
-                std::vector<int> counts(csize);
-                std::vector<int> displacements(csize);
+                const size_t max_size = load_max_count(options.fmessages);
+                std::vector<int> sizes;
+                for (size_t size = 1; size <= max_size; size *= 2) {
+                        sizes.push_back(static_cast<int>(size));
+                }
+                setup(max_size);
+                const double max_seconds = static_cast<double>(options.timeout) /
+                                           static_cast<double>(sizes.size() * algorithms.size());
 
-                MPI_Gather(&num_timings, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+                if (rank == 0 && options.verbose) {
+                        // @formatter:off
+                        std::cout << std::left
+                                  << std::setw(25) << "Algorithm"
+                                  << std::setw(25) << "Size (Bytes)"
+                                  << std::setw(25) << "Avg Latency (μs)"
+                                  << std::setw(25) << "Min Latency (μs)"
+                                  << std::setw(25) << "Max Latency (μs)"
+                                  << std::setw(25) << "Bandwidth (MB/s)"
+                                  << std::endl;
+                        // @formatter:on
+                }
 
-                if (rank == 0) {
-                        displacements[0] = 0;
-                        for (int i = 1; i < csize; ++i) {
-                                displacements[i] = displacements[i - 1] + counts[i - 1];
+                for (const std::string &algorithm : algorithms) {
+                        for (const int size : sizes) {
+                                run_size(algorithm, size, options.timer, max_seconds, options.verbose);
                         }
                 }
+        }
 
-                int total_timings = std::accumulate(counts.begin(), counts.end(), 0);
-                std::vector<double> all_timings(total_timings);
-
-                MPI_Gatherv(timings.data(),
-                            num_timings,
-                            MPI_DOUBLE,
-                            all_timings.data(),
-                            counts.data(),
-                            displacements.data(),
-                            MPI_DOUBLE,
-                            0,
-                            MPI_COMM_WORLD);
-
+        // Save the latency/bandwidth curve to file
+        void save_latencies(const std::string &filename, const bool verbose = false) const
+        {
                 if (rank == 0) {
                         std::ofstream out_file(filename);
                         if (!out_file) {
                                 std::cerr << "Error: Unable to open file " << filename << " for writing." << std::endl;
                                 exit(EXIT_FAILURE);
                         }
-                        // TODO: Alternative formats to csv
-                        out_file << "Rank,Iteration,Latency\n";
-                        int idx = 0;
-                        for (int r = 0; r < csize; ++r) {
-                                for (int i = 0; i < counts[r]; ++i) {
-                                        out_file << r << "," << i << "," << all_timings[idx++] << "\n";
-                                }
+                        out_file << "Algorithm,Bytes,Avg Latency,Min Latency,Max Latency,Bandwidth\n";
+                        for (const CurvePoint &point : curve) {
+                                out_file << point.algorithm << ","
+                                         << point.bytes << ","
+                                         << point.avg << ","
+                                         << point.min << ","
+                                         << point.max << ","
+                                         << (point.avg > 0.0 ? static_cast<double>(point.bytes) / point.avg : 0.0) << "\n";
                         }
                         out_file.close();
                         if (verbose) {
@@ -184,59 +222,22 @@ public:
 
 int main(int argc, char *argv[])
 {
-        const option long_options[] = {{"help", no_argument, nullptr, 'h'},
-                                       {"fmessages", required_argument, nullptr, 'm'},
-                                       {"foutput", required_argument, nullptr, 'o'},
-                                       {"timeout", required_argument, nullptr, 't'},
-                                       {"verbose", no_argument, nullptr, 'v'},
-                                       {nullptr, 0, nullptr, 0}};
-
-        std::string foutput = "default_output.txt";
-        int timeout = 10;
-        bool verbose = false;
-        int opt;
-
-        while ((opt = getopt_long(argc, argv, "hm:o:n:t:v", long_options, nullptr)) != -1) {
-                switch (opt) {
-                case 'h':
-                        // @formatter:off
-                        std::cout << "Help: This program runs a MPI bcast\n"
-                                  << "Options:\n"
-                                  << "  -h, --help            Show this help message\n"
-                                  << "  -m, --fmessages FILE  Specify file with messages (default: default_messages.txt)\n"
-                                  << "  -o, --foutput FILE    Specify output file (default: default_output.txt)\n"
-                                  << "  -t, --timeout NUM     Specify timeout value in seconds (default: 10)\n"
-                                  << "  -v, --verbose         Enable verbose mode\n";
-                        // @formatter:on
-                        return EXIT_SUCCESS;
-                case 'm':
-                        // Not implemented
-                        break;
-                case 'o':
-                        foutput = optarg;
-                        break;
-                case 'v':
-                        verbose = true;
-                        break;
-                case 't':
-                        timeout = std::stoi(optarg);
-                        break;
-                default:
-                        std::cerr << "Unknown option\n";
-                        std::cerr << optarg << std::endl;
-                        return EXIT_FAILURE;
-                }
+        init_mpi(argc, argv);
+
+        Options options;
+        if (const auto status = parse_options(argc, argv, "bcast", options)) {
+                MPI_Finalize();
+                return *status;
         }
 
-        MPI_Init(&argc, &argv);
         try {
                 Bcast benchmark;
-                benchmark.run(1024, timeout, verbose);
-                benchmark.save_latencies(foutput, verbose);
+                benchmark.run(options);
+                benchmark.save_latencies(options.foutput, options.verbose);
         } catch (const std::exception &e) {
                 std::cerr << "Error: " << e.what() << std::endl;
                 MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
         }
         MPI_Finalize();
         return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,325 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "format.hpp"
+
+// Read-only mapping of a binary result file
+class ResultFile {
+        int fd = -1;
+        size_t bytes = 0;
+        const char *data = nullptr;
+
+public:
+        ResultHeader header{};
+
+        explicit ResultFile(const std::string &filename)
+        {
+                fd = open(filename.c_str(), O_RDONLY);
+                if (fd < 0) {
+                        throw std::runtime_error("Could not open file " + filename);
+                }
+
+                struct stat st{};
+                fstat(fd, &st);
+                bytes = st.st_size;
+                if (bytes < sizeof(ResultHeader)) {
+                        throw std::runtime_error("File too small for a result header " + filename);
+                }
+
+                void *ptr = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (ptr == MAP_FAILED) {
+                        throw std::runtime_error("Could not map file " + filename);
+                }
+                data = static_cast<const char *>(ptr);
+
+                std::memcpy(&header, data, sizeof(ResultHeader));
+                if (!valid_result_header(header)) {
+                        throw std::runtime_error("Not a result file of version " + std::to_string(RESULT_VERSION));
+                }
+                if (bytes < result_file_size(header)) {
+                        throw std::runtime_error("File is truncated " + filename);
+                }
+        }
+
+        ResultFile(const ResultFile &) = delete;
+        ResultFile &operator=(const ResultFile &) = delete;
+
+        ~ResultFile()
+        {
+                if (data != nullptr) {
+                        munmap(const_cast<char *>(data), bytes);
+                }
+                if (fd >= 0) {
+                        close(fd);
+                }
+        }
+
+        [[nodiscard]] double base(const uint32_t rank) const
+        {
+                double value;
+                std::memcpy(&value, data + header.header_size + rank * sizeof(double), sizeof(double));
+                return value;
+        }
+
+        // Encoded value i of column (0 start delta, 1 duration) of rank
+        [[nodiscard]] uint64_t value(const int column, const uint32_t rank, const uint64_t i) const
+        {
+                const char *ptr = data + result_column_offset(header, column, rank) + i * header.delta_size;
+                if (header.delta_size == sizeof(uint32_t)) {
+                        uint32_t v;
+                        std::memcpy(&v, ptr, sizeof(v));
+                        return v;
+                }
+                uint64_t v;
+                std::memcpy(&v, ptr, sizeof(v));
+                return v;
+        }
+};
+
+// Read-only mapping of the per-process stream files written with --stream
+class StreamFile {
+        int fd = -1;
+        size_t bytes = 0;
+        const uint8_t *data = nullptr;
+
+public:
+        StreamHeader header{};
+
+        explicit StreamFile(const std::string &filename)
+        {
+                fd = open(filename.c_str(), O_RDONLY);
+                if (fd < 0) {
+                        throw std::runtime_error("Could not open file " + filename);
+                }
+
+                struct stat st{};
+                fstat(fd, &st);
+                bytes = st.st_size;
+                if (bytes < sizeof(StreamHeader)) {
+                        throw std::runtime_error("File too small for a stream header " + filename);
+                }
+
+                void *ptr = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (ptr == MAP_FAILED) {
+                        throw std::runtime_error("Could not map file " + filename);
+                }
+                data = static_cast<const uint8_t *>(ptr);
+
+                std::memcpy(&header, data, sizeof(StreamHeader));
+                if (!valid_stream_header(header)) {
+                        throw std::runtime_error("Not a stream file of version " + std::to_string(STREAM_VERSION));
+                }
+        }
+
+        StreamFile(const StreamFile &) = delete;
+        StreamFile &operator=(const StreamFile &) = delete;
+
+        ~StreamFile()
+        {
+                if (data != nullptr) {
+                        munmap(const_cast<uint8_t *>(data), bytes);
+                }
+                if (fd >= 0) {
+                        close(fd);
+                }
+        }
+
+        // Call f(iteration, start ticks, duration ticks) for every sample
+        template <typename F>
+        void decode(F &&f) const
+        {
+                auto varint = [&](size_t &pos)
+                {
+                        uint64_t v = 0;
+                        for (int shift = 0; pos < bytes; shift += 7) {
+                                const uint8_t byte = data[pos++];
+                                v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                                if ((byte & 0x80) == 0) {
+                                        break;
+                                }
+                        }
+                        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+                };
+
+                uint64_t iteration = 0;
+                int64_t start = 0;
+                size_t pos = header.header_size;
+                while (pos + 2 * sizeof(uint32_t) <= bytes) {
+                        uint32_t samples, payload;
+                        std::memcpy(&samples, data + pos, sizeof(uint32_t));
+                        std::memcpy(&payload, data + pos + sizeof(uint32_t), sizeof(uint32_t));
+                        pos += 2 * sizeof(uint32_t);
+                        if (pos + payload > bytes) {
+                                throw std::runtime_error("Stream of rank " + std::to_string(header.rank) + " is truncated");
+                        }
+                        for (uint32_t i = 0; i < samples; ++i) {
+                                start += varint(pos);
+                                const int64_t duration = varint(pos);
+                                f(iteration++, start, duration);
+                        }
+                }
+        }
+};
+
+bool is_stream_file(const std::string &filename)
+{
+        std::ifstream file(filename, std::ios::binary);
+        char magic[sizeof(STREAM_MAGIC)] = {};
+        file.read(magic, sizeof(magic));
+        return std::memcmp(magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)) == 0;
+}
+
+// Same layout as the CSV written by the benchmarks
+void write_csv(const ResultFile &results, std::ostream &out)
+{
+        const ResultHeader &header = results.header;
+
+        for (uint32_t r = 0; r < header.nproc; ++r) {
+                const double base = results.base(r);
+                uint64_t ticks = 0;
+                for (uint64_t i = 0; i < header.samples; ++i) {
+                        ticks += results.value(0, r, i);
+                        const uint64_t duration = results.value(1, r, i);
+                        out << r << ","
+                            << i << ","
+                            << std::fixed << std::setprecision(8) << base + ticks * header.resolution << ","
+                            << std::fixed << std::setprecision(8) << base + (ticks + duration) * header.resolution << "\n";
+                }
+        }
+}
+
+void write_csv(const StreamFile &stream, std::ostream &out)
+{
+        const StreamHeader &header = stream.header;
+
+        stream.decode([&](const uint64_t i, const int64_t start, const int64_t duration)
+        {
+                out << header.rank << ","
+                    << i << ","
+                    << std::fixed << std::setprecision(8) << stream_to_global(header, header.base + start * header.resolution) << ","
+                    << std::fixed << std::setprecision(8) << stream_to_global(header, header.base + (start + duration) * header.resolution) << "\n";
+        });
+}
+
+void write_info(const ResultFile &results, std::ostream &out)
+{
+        const ResultHeader &header = results.header;
+
+        // @formatter:off
+        out << std::left << std::setw(25) << "Version" << header.version << "\n"
+                         << std::setw(25) << "Collective" << header.collective << "\n"
+                         << std::setw(25) << "Distribution" << header.distribution << "\n"
+                         << std::setw(25) << "Processes" << header.nproc << "\n"
+                         << std::setw(25) << "Data type" << header.dtype << "\n"
+                         << std::setw(25) << "Samples per process" << header.samples << "\n"
+                         << std::setw(25) << "Bytes per value" << header.delta_size << "\n"
+                         << std::setw(25) << "Resolution (s)" << header.resolution << "\n"
+                         << std::setw(25) << "Timer" << header.timer << "\n"
+                         << std::setw(25) << "Timer resolution (s)" << header.timer_resolution << "\n"
+                         << std::setw(25) << "Timer overhead (s)" << header.timer_overhead << "\n"
+                         << std::setw(25) << "MPI library" << header.mpi_library << "\n";
+        // @formatter:on
+}
+
+void write_info(const StreamFile &stream, std::ostream &out)
+{
+        const StreamHeader &header = stream.header;
+
+        uint64_t samples = 0;
+        stream.decode([&](uint64_t, int64_t, int64_t) { ++samples; });
+
+        // @formatter:off
+        out << std::left << std::setw(25) << "Version" << header.version << "\n"
+                         << std::setw(25) << "Collective" << header.collective << "\n"
+                         << std::setw(25) << "Distribution" << header.distribution << "\n"
+                         << std::setw(25) << "Rank" << header.rank << " of " << header.nproc << "\n"
+                         << std::setw(25) << "Data type" << header.dtype << "\n"
+                         << std::setw(25) << "Samples" << samples << "\n"
+                         << std::setw(25) << "Resolution (s)" << header.resolution << "\n"
+                         << std::setw(25) << "Timer" << header.timer << "\n"
+                         << std::setw(25) << "Timer resolution (s)" << header.timer_resolution << "\n"
+                         << std::setw(25) << "Timer overhead (s)" << header.timer_overhead << "\n"
+                         << std::setw(25) << "Clock offset (s)" << header.clock_offset << "\n"
+                         << std::setw(25) << "Clock drift" << header.clock_drift << "\n";
+        // @formatter:on
+}
+
+int main(int argc, char *argv[])
+{
+        const option long_options[] = {{"help", no_argument, nullptr, 'h'},
+                                       {"foutput", required_argument, nullptr, 'o'},
+                                       {"info", no_argument, nullptr, 'i'},
+                                       {nullptr, 0, nullptr, 0}};
+
+        std::string foutput;
+        bool info = false;
+
+        int opt;
+        while ((opt = getopt_long(argc, argv, "ho:i", long_options, nullptr)) != -1) {
+                switch (opt) {
+                case 'h':
+                        // @formatter:off
+                        std::cout << "Help: This program converts binary result files or --stream files to CSV\n"
+                                  << "Usage: bin2csv [options] FILE...\n"
+                                  << "Options:\n"
+                                  << "  -h, --help            Show this help message\n"
+                                  << "  -o, --foutput FILE    Specify output file (default: standard output)\n"
+                                  << "  -i, --info            Print the run metadata instead of the samples\n";
+                        // @formatter:on
+                        return EXIT_SUCCESS;
+                case 'o':
+                        foutput = optarg;
+                        break;
+                case 'i':
+                        info = true;
+                        break;
+                default:
+                        std::cerr << "Unknown option" << std::endl;
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (optind >= argc) {
+                std::cerr << "ERROR: Expected at least one input file" << std::endl;
+                return EXIT_FAILURE;
+        }
+
+        try {
+                std::ofstream out_file;
+                if (!foutput.empty()) {
+                        out_file.open(foutput);
+                        if (!out_file) {
+                                std::cerr << "ERROR: Unable to open file " << foutput << " for writing." << std::endl;
+                                return EXIT_FAILURE;
+                        }
+                }
+                std::ostream &out = foutput.empty() ? std::cout : out_file;
+
+                if (!info) {
+                        out << "Rank,Iteration,Starttime,Endtime\n";
+                }
+                for (int i = optind; i < argc; ++i) {
+                        if (is_stream_file(argv[i])) {
+                                const StreamFile stream(argv[i]);
+                                info ? write_info(stream, out) : write_csv(stream, out);
+                        } else {
+                                const ResultFile results(argv[i]);
+                                info ? write_info(results, out) : write_csv(results, out);
+                        }
+                }
+        } catch (const std::exception &e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
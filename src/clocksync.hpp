@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <mpi.h>
+
+#include "timer.hpp"
+
+// Offset samples per process, spread over the synchronization phase to estimate the drift
+constexpr int CLOCK_SYNC_FIT_POINTS = 16;
+// Ping-pongs per offset sample, the one with the smallest round-trip time is used
+constexpr int CLOCK_SYNC_PINGPONGS = 20;
+constexpr int CLOCK_SYNC_TAG = 7001;
+
+// Linear model of a process' clock against the clock of rank 0. At local time t the local clock
+// is ahead of rank 0 by offset + drift * (t - reference) seconds.
+struct ClockModel {
+        double reference = 0.0;
+        double offset = 0.0;
+        double drift = 0.0;
+
+        [[nodiscard]] double offset_at(const double local) const noexcept
+        {
+                return offset + drift * (local - reference);
+        }
+
+        // Local timestamp on the clock of rank 0
+        [[nodiscard]] double to_global(const double local) const noexcept
+        {
+                return local - offset_at(local);
+        }
+
+        // Local time at which the clock of rank 0 shows global
+        [[nodiscard]] double to_local(const double global) const noexcept
+        {
+                return (global + offset - drift * reference) / (1.0 - drift);
+        }
+
+        // Model through the offsets of two synchronizations, e.g. before and after a run, which
+        // gives a much better drift estimate than a single short synchronization phase
+        static ClockModel between(const ClockModel &before, const ClockModel &after)
+        {
+                const double span = after.reference - before.reference;
+                if (span <= 0.0) {
+                        return before;
+                }
+                return {before.reference, before.offset, (after.offset - before.offset) / span};
+        }
+};
+
+// Rank 0 answers every ping with its current time
+inline void serve_pingpongs(const Timer &timer, const int peer, const MPI_Comm comm)
+{
+        for (int i = 0; i < CLOCK_SYNC_PINGPONGS; ++i) {
+                MPI_Recv(nullptr, 0, MPI_BYTE, peer, CLOCK_SYNC_TAG, comm, MPI_STATUS_IGNORE);
+                const double t_root = timer.now();
+                MPI_Send(&t_root, 1, MPI_DOUBLE, peer, CLOCK_SYNC_TAG, comm);
+        }
+}
+
+// Offset against rank 0 from the ping-pong with the smallest round-trip time. Assuming symmetric
+// latencies rank 0 read its clock in the middle of the round trip.
+inline void sample_offset(const Timer &timer, const MPI_Comm comm, double &local, double &offset)
+{
+        double best_rtt = std::numeric_limits<double>::max();
+        for (int i = 0; i < CLOCK_SYNC_PINGPONGS; ++i) {
+                double t_root;
+                const double t0 = timer.now();
+                MPI_Send(nullptr, 0, MPI_BYTE, 0, CLOCK_SYNC_TAG, comm);
+                MPI_Recv(&t_root, 1, MPI_DOUBLE, 0, CLOCK_SYNC_TAG, comm, MPI_STATUS_IGNORE);
+                const double t1 = timer.now();
+
+                if (t1 - t0 < best_rtt) {
+                        best_rtt = t1 - t0;
+                        local = (t0 + t1) / 2.0;
+                        offset = local - t_root;
+                }
+        }
+}
+
+// Estimate offset and drift of every process against rank 0 with a least squares fit through
+// CLOCK_SYNC_FIT_POINTS offset samples. Rank 0 synchronizes with one process after the other.
+// Every process reads the same timer as in the measurement.
+inline ClockModel synchronize_clocks(const Timer &timer, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        ClockModel model;
+        MPI_Barrier(comm);
+        if (rank == 0) {
+                model.reference = timer.now();
+                for (int r = 1; r < csize; ++r) {
+                        for (int p = 0; p < CLOCK_SYNC_FIT_POINTS; ++p) {
+                                serve_pingpongs(timer, r, comm);
+                        }
+                }
+        } else {
+                std::vector<double> locals(CLOCK_SYNC_FIT_POINTS);
+                std::vector<double> offsets(CLOCK_SYNC_FIT_POINTS);
+                for (int p = 0; p < CLOCK_SYNC_FIT_POINTS; ++p) {
+                        sample_offset(timer, comm, locals[p], offsets[p]);
+                }
+
+                double mean_local = 0.0, mean_offset = 0.0;
+                for (int p = 0; p < CLOCK_SYNC_FIT_POINTS; ++p) {
+                        mean_local += locals[p] / CLOCK_SYNC_FIT_POINTS;
+                        mean_offset += offsets[p] / CLOCK_SYNC_FIT_POINTS;
+                }
+                double cov = 0.0, var = 0.0;
+                for (int p = 0; p < CLOCK_SYNC_FIT_POINTS; ++p) {
+                        cov += (locals[p] - mean_local) * (offsets[p] - mean_offset);
+                        var += (locals[p] - mean_local) * (locals[p] - mean_local);
+                }
+
+                model.reference = mean_local;
+                model.offset = mean_offset;
+                model.drift = var > 0.0 ? cov / var : 0.0;
+        }
+        MPI_Barrier(comm);
+        return model;
+}
+
+// Root prints the largest offset and drift of any process against rank 0
+inline void report_clocks(const ClockModel &model, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        const double local[2] = {std::abs(model.offset), std::abs(model.drift)};
+        double global[2] = {0.0, 0.0};
+        MPI_Reduce(local, global, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+        if (rank == 0) {
+                std::cout << "Clocks synchronized, offset up to " << global[0] * 1e6 << " us, drift up to "
+                          << global[1] * 1e6 << " ppm" << std::endl;
+        }
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+// Alignment of derived members and of the per-peer blocks in a buffer
+constexpr MPI_Aint DATATYPE_ALIGNMENT = 8;
+
+inline std::string trim(const std::string &s)
+{
+        const auto begin = std::find_if_not(s.begin(), s.end(), [](unsigned char c) { return std::isspace(c); });
+        const auto end = std::find_if_not(s.rbegin(), s.rend(), [](unsigned char c) { return std::isspace(c); }).base();
+        return begin < end ? std::string(begin, end) : std::string();
+}
+
+// Split at top-level commas, commas inside parentheses belong to nested types
+inline std::vector<std::string> split_arguments(const std::string &s)
+{
+        std::vector<std::string> args;
+        int depth = 0;
+        std::string current;
+        for (const char c : s) {
+                if (c == ',' && depth == 0) {
+                        args.push_back(trim(current));
+                        current.clear();
+                        continue;
+                }
+                depth += c == '(' ? 1 : c == ')' ? -1 : 0;
+                current += c;
+        }
+        args.push_back(trim(current));
+        return args;
+}
+
+inline MPI_Aint round_up(const MPI_Aint n, const MPI_Aint alignment)
+{
+        return (n + alignment - 1) / alignment * alignment;
+}
+
+// Creates and owns MPI datatypes from a textual description:
+//
+//   char | int | float | double | long
+//   contiguous(COUNT,TYPE)
+//   vector(COUNT,BLOCKLENGTH,STRIDE,TYPE)
+//   struct(TYPE,TYPE,...)               members at naturally aligned offsets
+//
+// Identical descriptions share one committed datatype, which is freed with the cache.
+class DatatypeCache {
+        std::map<std::string, MPI_Datatype> types;
+        std::vector<MPI_Datatype> derived;
+
+        [[noreturn]] static void invalid(const std::string &spec)
+        {
+                std::cerr << "ERROR: Invalid datatype " << spec << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                std::abort();
+        }
+
+        static MPI_Aint alignment(const MPI_Datatype type)
+        {
+                int size;
+                MPI_Type_size(type, &size);
+                return std::clamp<MPI_Aint>(size, 1, DATATYPE_ALIGNMENT);
+        }
+
+        MPI_Datatype create(const std::string &spec)
+        {
+                if (spec == "char") {
+                        return MPI_CHAR;
+                }
+                if (spec == "int") {
+                        return MPI_INT;
+                }
+                if (spec == "float") {
+                        return MPI_FLOAT;
+                }
+                if (spec == "double") {
+                        return MPI_DOUBLE;
+                }
+                if (spec == "long") {
+                        return MPI_LONG;
+                }
+
+                const size_t open = spec.find('(');
+                if (open == std::string::npos || spec.back() != ')') {
+                        invalid(spec);
+                }
+                const std::string kind = trim(spec.substr(0, open));
+                const std::vector<std::string> args = split_arguments(spec.substr(open + 1, spec.size() - open - 2));
+
+                MPI_Datatype type;
+                try {
+                        if (kind == "contiguous" && args.size() == 2) {
+                                MPI_Type_contiguous(std::stoi(args[0]), get(args[1]), &type);
+                        } else if (kind == "vector" && args.size() == 4) {
+                                MPI_Type_vector(std::stoi(args[0]), std::stoi(args[1]), std::stoi(args[2]), get(args[3]), &type);
+                        } else if (kind == "struct" && !args.empty()) {
+                                std::vector<int> blocklengths(args.size(), 1);
+                                std::vector<MPI_Aint> displacements(args.size());
+                                std::vector<MPI_Datatype> members(args.size());
+                                MPI_Aint offset = 0, max_alignment = 1;
+                                for (size_t i = 0; i < args.size(); ++i) {
+                                        members[i] = get(args[i]);
+                                        MPI_Aint lb, extent;
+                                        MPI_Type_get_extent(members[i], &lb, &extent);
+                                        offset = round_up(offset, alignment(members[i]));
+                                        displacements[i] = offset;
+                                        offset += extent;
+                                        max_alignment = std::max(max_alignment, alignment(members[i]));
+                                }
+                                MPI_Datatype packed;
+                                MPI_Type_create_struct(static_cast<int>(args.size()),
+                                                       blocklengths.data(),
+                                                       displacements.data(),
+                                                       members.data(),
+                                                       &packed);
+                                // Trailing padding like a C struct, so that arrays of it stay aligned
+                                MPI_Type_create_resized(packed, 0, round_up(offset, max_alignment), &type);
+                                MPI_Type_free(&packed);
+                        } else {
+                                invalid(spec);
+                        }
+                } catch (const std::logic_error &) {
+                        invalid(spec);
+                }
+
+                MPI_Type_commit(&type);
+                derived.push_back(type);
+                return type;
+        }
+
+public:
+        DatatypeCache() = default;
+        DatatypeCache(const DatatypeCache &) = delete;
+        DatatypeCache &operator=(const DatatypeCache &) = delete;
+
+        ~DatatypeCache()
+        {
+                for (MPI_Datatype &type : derived) {
+                        MPI_Type_free(&type);
+                }
+        }
+
+        MPI_Datatype get(const std::string &description)
+        {
+                std::string spec;
+                std::ranges::copy_if(description, std::back_inserter(spec), [](unsigned char c) { return !std::isspace(c); });
+
+                if (const auto it = types.find(spec); it != types.end()) {
+                        return it->second;
+                }
+                const MPI_Datatype type = create(spec);
+                types[spec] = type;
+                return type;
+        }
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Binary result format, all values in native (little) endianness:
+//
+//   ResultHeader                          header_size bytes
+//   double   base[nproc]                  first start time of every rank in seconds
+//   uintN_t  start_delta[nproc][samples]  ticks between consecutive start times, 0 for the first
+//   uintN_t  duration[nproc][samples]     ticks between start and end time
+//
+// N is 8 * delta_size and columns start at data_offset. Start times are quantized to ticks
+// relative to base before taking differences, so summing up the deltas is exact. Every column
+// is a plain 2D array and can be memory-mapped, e.g. with numpy.memmap.
+constexpr char RESULT_MAGIC[8] = {'M', 'P', 'I', 'B', 'E', 'N', 'C', 'H'};
+constexpr uint32_t RESULT_VERSION = 2;
+// Seconds per tick
+constexpr double RESULT_RESOLUTION = 1e-9;
+constexpr uint64_t RESULT_ALIGNMENT = 64;
+
+struct ResultHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint32_t nproc;
+        uint32_t delta_size;
+        uint64_t samples;
+        uint64_t data_offset;
+        double resolution;
+        char collective[32];
+        char distribution[256];
+        char dtype[16];
+        // Timer backend, its resolution and the overhead subtracted from every duration in seconds,
+        // the largest of all processes
+        char timer[16];
+        double timer_resolution;
+        double timer_overhead;
+        char mpi_library[640];
+};
+static_assert(sizeof(ResultHeader) == 1024);
+
+// Copy value into a zero-terminated fixed-size field, truncating if necessary
+template <size_t N>
+void set_field(char (&field)[N], const std::string &value)
+{
+        std::memset(field, 0, N);
+        std::memcpy(field, value.data(), std::min(value.size(), N - 1));
+}
+
+inline ResultHeader make_result_header(const uint32_t nproc, const uint64_t samples, const uint32_t delta_size)
+{
+        ResultHeader header{};
+        std::memcpy(header.magic, RESULT_MAGIC, sizeof(RESULT_MAGIC));
+        header.version = RESULT_VERSION;
+        header.header_size = sizeof(ResultHeader);
+        header.nproc = nproc;
+        header.delta_size = delta_size;
+        header.samples = samples;
+        header.resolution = RESULT_RESOLUTION;
+
+        const uint64_t bases = sizeof(ResultHeader) + nproc * sizeof(double);
+        header.data_offset = (bases + RESULT_ALIGNMENT - 1) / RESULT_ALIGNMENT * RESULT_ALIGNMENT;
+        return header;
+}
+
+inline bool valid_result_header(const ResultHeader &header)
+{
+        return std::memcmp(header.magic, RESULT_MAGIC, sizeof(RESULT_MAGIC)) == 0 &&
+               header.version == RESULT_VERSION && header.header_size == sizeof(ResultHeader) &&
+               (header.delta_size == 4 || header.delta_size == 8);
+}
+
+// Byte offset of the first value of a rank's column, column 0 is start_delta and 1 is duration
+inline uint64_t result_column_offset(const ResultHeader &header, const int column, const uint64_t rank)
+{
+        return header.data_offset + ((column * header.nproc) + rank) * header.samples * header.delta_size;
+}
+
+inline uint64_t result_file_size(const ResultHeader &header)
+{
+        return result_column_offset(header, 2, 0);
+}
+
+// Timestamp relative to base in ticks
+inline int64_t to_ticks(const double t, const double base)
+{
+        return std::llround((t - base) / RESULT_RESOLUTION);
+}
+
+// Stream format of --stream, one file per process:
+//
+//   StreamHeader                          header_size bytes
+//   blocks until the end of the file, each
+//     uint32_t samples
+//     uint32_t bytes                      size of the payload
+//     payload                             per sample two zigzag LEB128 varints, the start time
+//                                         in ticks minus the previous start time (base for the
+//                                         first one) and the duration in ticks
+//
+// Timestamps are stored on the local clock of the process. The clock model that maps them to the
+// clock of rank 0 is only known after the run, it is written into the header when the stream is
+// closed and applied by bin2csv to every block alike.
+constexpr char STREAM_MAGIC[8] = {'M', 'P', 'I', 'S', 'T', 'R', 'E', 'M'};
+constexpr uint32_t STREAM_VERSION = 3;
+
+struct StreamHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint32_t rank;
+        uint32_t nproc;
+        double base;
+        double resolution;
+        char collective[32];
+        char distribution[256];
+        char dtype[16];
+        char timer[16];
+        double timer_resolution;
+        double timer_overhead;
+        // Clock model of the run, local time t is t - (clock_offset + clock_drift * (t -
+        // clock_reference)) on the clock of rank 0, all zero without clock synchronization
+        double clock_reference;
+        double clock_offset;
+        double clock_drift;
+        char reserved[112];
+};
+static_assert(sizeof(StreamHeader) == 512);
+
+inline StreamHeader make_stream_header(const uint32_t rank, const uint32_t nproc, const double base)
+{
+        StreamHeader header{};
+        std::memcpy(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC));
+        header.version = STREAM_VERSION;
+        header.header_size = sizeof(StreamHeader);
+        header.rank = rank;
+        header.nproc = nproc;
+        header.base = base;
+        header.resolution = RESULT_RESOLUTION;
+        return header;
+}
+
+// Local timestamp of a stream on the clock of rank 0
+inline double stream_to_global(const StreamHeader &header, const double local)
+{
+        return local - (header.clock_offset + header.clock_drift * (local - header.clock_reference));
+}
+
+inline bool valid_stream_header(const StreamHeader &header)
+{
+        return std::memcmp(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)) == 0 &&
+               header.version == STREAM_VERSION && header.header_size == sizeof(StreamHeader);
+}
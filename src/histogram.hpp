@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <mpi.h>
+
+// Linear sub-buckets per power of two, 2^7 keeps the relative error of a bucket below 1%
+constexpr int HISTOGRAM_SUB_BUCKET_BITS = 7;
+constexpr uint64_t HISTOGRAM_SUB_BUCKETS = 1ULL << HISTOGRAM_SUB_BUCKET_BITS;
+// Largest value tracked with full precision is 2^40 ns (about 18 minutes)
+constexpr int HISTOGRAM_MAX_BITS = 40;
+constexpr size_t HISTOGRAM_BUCKETS = HISTOGRAM_SUB_BUCKETS * (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 2);
+// Width of a bucket relative to its lower edge at most, no percentile is known more precisely
+constexpr double HISTOGRAM_RESOLUTION = 1.0 / HISTOGRAM_SUB_BUCKETS;
+
+// Normal quantile of the two-sided 95% confidence intervals
+constexpr double CONFIDENCE_Z = 1.96;
+
+// Fixed-size log-linear latency histogram in the spirit of HdrHistogram. Values are recorded in
+// nanoseconds, values below HISTOGRAM_SUB_BUCKETS are exact and every power of two above is split
+// into HISTOGRAM_SUB_BUCKETS linear buckets. Recording is O(1) and the struct is trivially
+// copyable so that it can be merged across processes with a single MPI_Reduce.
+struct LatencyHistogram {
+        std::array<uint64_t, HISTOGRAM_BUCKETS> counts{};
+        uint64_t total = 0;
+        double sum = 0.0;
+        double min = std::numeric_limits<double>::max();
+        double max = 0.0;
+
+        static size_t bucket(const uint64_t ns) noexcept
+        {
+                if (ns < HISTOGRAM_SUB_BUCKETS) {
+                        return ns;
+                }
+                const int exponent = std::bit_width(ns) - 1 - HISTOGRAM_SUB_BUCKET_BITS;
+                const size_t idx = (exponent + 1) * HISTOGRAM_SUB_BUCKETS + ((ns >> exponent) - HISTOGRAM_SUB_BUCKETS);
+                return std::min(idx, HISTOGRAM_BUCKETS - 1);
+        }
+
+        // Smallest value of a bucket in nanoseconds
+        static double lower(const size_t idx) noexcept
+        {
+                if (idx < HISTOGRAM_SUB_BUCKETS) {
+                        return static_cast<double>(idx);
+                }
+                const int exponent = static_cast<int>(idx / HISTOGRAM_SUB_BUCKETS) - 1;
+                return static_cast<double>((HISTOGRAM_SUB_BUCKETS + idx % HISTOGRAM_SUB_BUCKETS) << exponent);
+        }
+
+        // Values of a bucket lie in [lower, lower + width)
+        static double width(const size_t idx) noexcept
+        {
+                if (idx < HISTOGRAM_SUB_BUCKETS) {
+                        return 1.0;
+                }
+                return static_cast<double>(1ULL << (idx / HISTOGRAM_SUB_BUCKETS - 1));
+        }
+
+        // Representative value of a bucket in nanoseconds, the middle of its range
+        static double value(const size_t idx) noexcept
+        {
+                return lower(idx) + (width(idx) - 1.0) / 2.0;
+        }
+
+        // Record a latency given in seconds
+        void record(const double seconds) noexcept
+        {
+                const double ns = std::max(seconds, 0.0) * 1e9;
+                counts[bucket(static_cast<uint64_t>(std::llround(ns)))]++;
+                total++;
+                sum += seconds;
+                min = std::min(min, seconds);
+                max = std::max(max, seconds);
+        }
+
+        void merge(const LatencyHistogram &other) noexcept
+        {
+                for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+                        counts[i] += other.counts[i];
+                }
+                total += other.total;
+                sum += other.sum;
+                min = std::min(min, other.min);
+                max = std::max(max, other.max);
+        }
+
+        // Bucket of the sample below which p percent of the samples fall
+        [[nodiscard]] size_t percentile_bucket(const double p) const noexcept
+        {
+                const auto target = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(total)));
+                uint64_t seen = 0;
+                for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+                        seen += counts[i];
+                        if (seen >= std::max<uint64_t>(target, 1)) {
+                                return i;
+                        }
+                }
+                return HISTOGRAM_BUCKETS - 1;
+        }
+
+        // Latency in seconds below which p percent of the samples fall
+        [[nodiscard]] double percentile(const double p) const noexcept
+        {
+                if (total == 0) {
+                        return 0.0;
+                }
+                return std::clamp(value(percentile_bucket(p)) * 1e-9, min, max);
+        }
+
+        // Half-width of the 95% confidence interval of the p-th percentile relative to its value. The
+        // interval is bounded by the order statistics n * q +- z * sqrt(n * q * (1 - q)) and spans
+        // from the lower edge of the bucket of the first to the upper edge of the bucket of the
+        // second, since the samples are only known to within their bucket. It is never tighter than
+        // HISTOGRAM_RESOLUTION.
+        [[nodiscard]] double percentile_error(const double p) const noexcept
+        {
+                const double mid = percentile(p);
+                if (total == 0 || mid <= 0.0) {
+                        return std::numeric_limits<double>::infinity();
+                }
+                const double q = p / 100.0;
+                const double spread = CONFIDENCE_Z * std::sqrt(q * (1.0 - q) / static_cast<double>(total));
+                const size_t first = percentile_bucket(std::max(q - spread, 0.0) * 100.0);
+                const size_t last = percentile_bucket(std::min(q + spread, 1.0) * 100.0);
+                const double lower_edge = lower(first) * 1e-9;
+                const double upper_edge = (lower(last) + width(last)) * 1e-9;
+                return std::max((upper_edge - lower_edge) / (2.0 * mid), HISTOGRAM_RESOLUTION);
+        }
+
+        [[nodiscard]] double mean() const noexcept
+        {
+                return total == 0 ? 0.0 : sum / static_cast<double>(total);
+        }
+};
+
+// MPI_User_function merging len histograms from in into inout
+inline void merge_histograms(void *in, void *inout, int *len, MPI_Datatype *)
+{
+        const auto *src = static_cast<const LatencyHistogram *>(in);
+        auto *dst = static_cast<LatencyHistogram *>(inout);
+        for (int i = 0; i < *len; ++i) {
+                dst[i].merge(src[i]);
+        }
+}
+
+// Merge the histograms of all processes into global on root
+inline void reduce_histograms(const LatencyHistogram &local,
+                              LatencyHistogram &global,
+                              const int root = 0,
+                              const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        MPI_Datatype type;
+        MPI_Type_contiguous(sizeof(LatencyHistogram), MPI_BYTE, &type);
+        MPI_Type_commit(&type);
+
+        MPI_Op op;
+        MPI_Op_create(merge_histograms, 1, &op);
+
+        MPI_Reduce(&local, &global, 1, type, op, root, comm);
+
+        MPI_Op_free(&op);
+        MPI_Type_free(&type);
+}
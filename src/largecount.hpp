@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <mpi.h>
+
+// Collectives with MPI_Count counts and MPI_Aint displacements of MPI 4.0, as detected by CMake.
+// Without them the blocking collectives are emulated with point-to-point messages.
+#ifdef HAVE_MPI_LARGE_COUNT
+constexpr bool LARGE_COUNT_COLLECTIVES = true;
+#else
+constexpr bool LARGE_COUNT_COLLECTIVES = false;
+
+// Tag of the messages of the emulated collectives
+constexpr int LARGE_COUNT_TAG = 7401;
+// Bytes per message of the emulated collectives, a block is split into messages of at most this
+// size so that neither the count nor the message size exceeds the range of int
+constexpr MPI_Count LARGE_COUNT_CHUNK_BYTES = 1 << 30;
+
+// Elements of type per message
+inline MPI_Count chunk_elements(const MPI_Datatype type)
+{
+        MPI_Aint lb, extent;
+        MPI_Type_get_extent(type, &lb, &extent);
+        return std::clamp<MPI_Count>(LARGE_COUNT_CHUNK_BYTES / std::max<MPI_Aint>(extent, 1), 1, INT_MAX);
+}
+
+// Post the messages of one block of count elements at displacement displ in extents of type,
+// messages between the same pair with the same tag are matched in order
+inline void isend_chunks(const void *buf,
+                         const MPI_Aint displ,
+                         const MPI_Count count,
+                         const MPI_Datatype type,
+                         const int dest,
+                         const MPI_Comm comm,
+                         std::vector<MPI_Request> &requests)
+{
+        MPI_Aint lb, extent;
+        MPI_Type_get_extent(type, &lb, &extent);
+        const MPI_Count chunk = chunk_elements(type);
+        const char *block = static_cast<const char *>(buf) + displ * extent;
+        for (MPI_Count offset = 0; offset < count; offset += chunk) {
+                requests.emplace_back();
+                MPI_Isend(block + offset * extent,
+                          static_cast<int>(std::min(chunk, count - offset)),
+                          type,
+                          dest,
+                          LARGE_COUNT_TAG,
+                          comm,
+                          &requests.back());
+        }
+}
+
+inline void irecv_chunks(void *buf,
+                         const MPI_Aint displ,
+                         const MPI_Count count,
+                         const MPI_Datatype type,
+                         const int source,
+                         const MPI_Comm comm,
+                         std::vector<MPI_Request> &requests)
+{
+        MPI_Aint lb, extent;
+        MPI_Type_get_extent(type, &lb, &extent);
+        const MPI_Count chunk = chunk_elements(type);
+        char *block = static_cast<char *>(buf) + displ * extent;
+        for (MPI_Count offset = 0; offset < count; offset += chunk) {
+                requests.emplace_back();
+                MPI_Irecv(block + offset * extent,
+                          static_cast<int>(std::min(chunk, count - offset)),
+                          type,
+                          source,
+                          LARGE_COUNT_TAG,
+                          comm,
+                          &requests.back());
+        }
+}
+
+[[noreturn]] inline void large_count_unavailable()
+{
+        std::cerr << "ERROR: MPI library lacks large-count collectives" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        std::abort();
+}
+#endif
+
+inline void scatterv_c(const void *sendbuf,
+                       const MPI_Count sendcounts[],
+                       const MPI_Aint displs[],
+                       const MPI_Datatype sendtype,
+                       void *recvbuf,
+                       const MPI_Count recvcount,
+                       const MPI_Datatype recvtype,
+                       const int root,
+                       const MPI_Comm comm)
+{
+#ifdef HAVE_MPI_LARGE_COUNT
+        MPI_Scatterv_c(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+#else
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        std::vector<MPI_Request> requests;
+        irecv_chunks(recvbuf, 0, recvcount, recvtype, root, comm, requests);
+        if (rank == root) {
+                for (int i = 0; i < csize; ++i) {
+                        isend_chunks(sendbuf, displs[i], sendcounts[i], sendtype, i, comm, requests);
+                }
+        }
+        MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+#endif
+}
+
+inline void gatherv_c(const void *sendbuf,
+                      const MPI_Count sendcount,
+                      const MPI_Datatype sendtype,
+                      void *recvbuf,
+                      const MPI_Count recvcounts[],
+                      const MPI_Aint displs[],
+                      const MPI_Datatype recvtype,
+                      const int root,
+                      const MPI_Comm comm)
+{
+#ifdef HAVE_MPI_LARGE_COUNT
+        MPI_Gatherv_c(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+#else
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        std::vector<MPI_Request> requests;
+        if (rank == root) {
+                for (int i = 0; i < csize; ++i) {
+                        irecv_chunks(recvbuf, displs[i], recvcounts[i], recvtype, i, comm, requests);
+                }
+        }
+        isend_chunks(sendbuf, 0, sendcount, sendtype, root, comm, requests);
+        MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+#endif
+}
+
+inline void allgatherv_c(const void *sendbuf,
+                         const MPI_Count sendcount,
+                         const MPI_Datatype sendtype,
+                         void *recvbuf,
+                         const MPI_Count recvcounts[],
+                         const MPI_Aint displs[],
+                         const MPI_Datatype recvtype,
+                         const MPI_Comm comm)
+{
+#ifdef HAVE_MPI_LARGE_COUNT
+        MPI_Allgatherv_c(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+#else
+        int csize;
+        MPI_Comm_size(comm, &csize);
+
+        std::vector<MPI_Request> requests;
+        for (int i = 0; i < csize; ++i) {
+                irecv_chunks(recvbuf, displs[i], recvcounts[i], recvtype, i, comm, requests);
+        }
+        for (int i = 0; i < csize; ++i) {
+                isend_chunks(sendbuf, 0, sendcount, sendtype, i, comm, requests);
+        }
+        MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+#endif
+}
+
+inline void alltoallv_c(const void *sendbuf,
+                        const MPI_Count sendcounts[],
+                        const MPI_Aint sdispls[],
+                        const MPI_Datatype sendtype,
+                        void *recvbuf,
+                        const MPI_Count recvcounts[],
+                        const MPI_Aint rdispls[],
+                        const MPI_Datatype recvtype,
+                        const MPI_Comm comm)
+{
+#ifdef HAVE_MPI_LARGE_COUNT
+        MPI_Alltoallv_c(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+#else
+        int csize;
+        MPI_Comm_size(comm, &csize);
+
+        std::vector<MPI_Request> requests;
+        for (int i = 0; i < csize; ++i) {
+                irecv_chunks(recvbuf, rdispls[i], recvcounts[i], recvtype, i, comm, requests);
+        }
+        for (int i = 0; i < csize; ++i) {
+                isend_chunks(sendbuf, sdispls[i], sendcounts[i], sendtype, i, comm, requests);
+        }
+        MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+#endif
+}
+
+inline void ialltoallv_c(const void *sendbuf,
+                         const MPI_Count sendcounts[],
+                         const MPI_Aint sdispls[],
+                         const MPI_Datatype sendtype,
+                         void *recvbuf,
+                         const MPI_Count recvcounts[],
+                         const MPI_Aint rdispls[],
+                         const MPI_Datatype recvtype,
+                         const MPI_Comm comm,
+                         MPI_Request *request)
+{
+#ifdef HAVE_MPI_LARGE_COUNT
+        MPI_Ialltoallv_c(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, request);
+#else
+        large_count_unavailable();
+#endif
+}
+
+// Large-count collectives imply MPI 4.0, which also has the persistent ones
+inline void alltoallv_init_c(const void *sendbuf,
+                             const MPI_Count sendcounts[],
+                             const MPI_Aint sdispls[],
+                             const MPI_Datatype sendtype,
+                             void *recvbuf,
+                             const MPI_Count recvcounts[],
+                             const MPI_Aint rdispls[],
+                             const MPI_Datatype recvtype,
+                             const MPI_Comm comm,
+                             MPI_Request *request)
+{
+#ifdef HAVE_MPI_LARGE_COUNT
+        MPI_Alltoallv_init_c(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, MPI_INFO_NULL, request);
+#else
+        large_count_unavailable();
+#endif
+}
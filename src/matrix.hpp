@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+// Load a many-to-many distribution from a CSV file with one line per sender and one column per
+// receiver. Root reads the file and distributes it, every process gets its row as sendcounts and
+// its column as recvcounts. Counts are read as 64-bit integers, callers without large-count
+// variants have to check them against the range of int.
+inline void load_m2m(const std::string &filename,
+                     std::vector<long long> &sendcounts,
+                     std::vector<long long> &recvcounts,
+                     const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        sendcounts.resize(csize);
+        recvcounts.resize(csize);
+        if (rank == 0) {
+                std::vector rows(csize, std::vector<long long>(csize));
+                std::vector columns(csize, std::vector<long long>(csize));
+
+                std::ifstream file(filename);
+                if (!file) {
+                        std::cerr << "ERROR: Could not open file " << filename << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                int prc = 0;
+                std::string line;
+                while (std::getline(file, line)) {
+                        std::istringstream ss(line);
+                        std::vector<long long> row(csize, 0);
+                        std::string val;
+
+                        int idx = 0;
+                        while (std::getline(ss, val, ',')) {
+                                if (idx == csize) {
+                                        // @formatter:off
+                                        std::cerr << "ERROR: Number of columns "
+                                                  << "(" << idx + 1 << ") "
+                                                  << "does not match number of processes "
+                                                  << "(" << csize << ")."
+                                                  << std::endl;
+                                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                                        // @formatter:on
+                                }
+                                try {
+                                        row[idx] = std::stoll(val);
+                                } catch (const std::logic_error &) {
+                                        std::cerr << "ERROR: Invalid message data found " << std::endl;
+                                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                                }
+                                if (row[idx] < 0) {
+                                        std::cerr << "ERROR: Negative message size in " << filename << std::endl;
+                                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                                }
+                                idx++;
+                        }
+
+                        if (idx < csize) {
+                                // @formatter:off
+                                std::cerr << "ERROR: Number of columns "
+                                          << "(" << idx << ") "
+                                          << "does not match number of processes "
+                                          << "(" << csize << ")."
+                                          << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                                // @formatter:on
+                        }
+
+                        if (prc == csize) {
+                                std::cerr << "ERROR: Too many lines in file " << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+
+                        rows[prc] = row;
+                        for (int i = 0; i < csize; ++i) {
+                                columns[i][prc] = row[i];
+                        }
+                        prc++;
+                }
+
+                if (prc != csize) {
+                        std::cerr << "ERROR: Not enough lines in file " << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                file.close();
+
+                // Root keeps its own row and column
+                sendcounts = rows[0];
+                recvcounts = columns[0];
+                for (int i = 1; i < csize; ++i) {
+                        MPI_Send(rows[i].data(), csize, MPI_LONG_LONG, i, 0, comm);
+                        MPI_Send(columns[i].data(), csize, MPI_LONG_LONG, i, 0, comm);
+                }
+
+        } else {
+                MPI_Recv(sendcounts.data(), csize, MPI_LONG_LONG, 0, 0, comm, MPI_STATUS_IGNORE);
+                MPI_Recv(recvcounts.data(), csize, MPI_LONG_LONG, 0, 0, comm, MPI_STATUS_IGNORE);
+        }
+}
+
+// Load a rooted distribution from a CSV file with a single line and one column per process, the
+// count of block i. Root reads the file and broadcasts the counts, which may exceed the range of
+// int for the large-count collectives.
+inline std::vector<long long> load_counts(const std::string &filename, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        std::vector<long long> counts(csize);
+        if (rank == 0) {
+                std::ifstream file(filename);
+                if (!file) {
+                        std::cerr << "ERROR: Could not open file " << filename << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                std::string line;
+                if (!std::getline(file, line)) {
+                        std::cerr << "ERROR: Could not read line " << filename << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                std::istringstream ss(line);
+                std::vector<long long> row;
+                std::string val;
+                while (std::getline(ss, val, ',')) {
+                        try {
+                                row.push_back(std::stoll(val));
+                        } catch (const std::logic_error &) {
+                                std::cerr << "ERROR: Invalid message data found " << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                        if (row.back() < 0) {
+                                std::cerr << "ERROR: Negative message size in " << filename << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                }
+                file.close();
+
+                if (row.size() != csize) {
+                        // @formatter:off
+                        std::cerr << "ERROR: Number of columns "
+                                  << "(" << row.size() << ") "
+                                  << "does not match number of processes "
+                                  << "(" << csize << ")." << std::endl;
+                        // @formatter:on
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                std::ranges::copy(row, counts.begin());
+        }
+
+        MPI_Bcast(counts.data(), csize, MPI_LONG_LONG, 0, comm);
+        return counts;
+}
+
+// Largest count anywhere in a distribution file, read on root and broadcast, the end of the size
+// sweeps of bcast and p2p
+inline size_t load_max_count(const std::string &filename, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        long long max_size = 0;
+        if (rank == 0) {
+                std::ifstream file(filename);
+                if (!file) {
+                        std::cerr << "ERROR: Could not open file " << filename << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                std::string line;
+                while (std::getline(file, line)) {
+                        std::istringstream ss(line);
+                        std::string val;
+                        while (std::getline(ss, val, ',')) {
+                                try {
+                                        max_size = std::max(max_size, std::stoll(val));
+                                } catch (const std::logic_error &) {
+                                        std::cerr << "ERROR: Invalid message data found " << std::endl;
+                                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                                }
+                        }
+                }
+                if (max_size < 1 || max_size > std::numeric_limits<int>::max()) {
+                        std::cerr << "ERROR: Largest message size in " << filename << " out of range" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+        MPI_Bcast(&max_size, 1, MPI_LONG_LONG, 0, comm);
+        return static_cast<size_t>(max_size);
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+// Share of the available memory that the buffers of a benchmark may take, the rest is left to the
+// MPI library and the system
+constexpr double MEMORY_BUDGET = 0.8;
+
+// Limits of cgroup v1 at or above this value mean no limit
+constexpr long long CGROUP_UNLIMITED = 1LL << 62;
+
+// Number in a cgroup file, -1 if the file is missing or holds no limit ("max")
+inline long long read_cgroup_value(const std::filesystem::path &filename)
+{
+        std::ifstream file(filename);
+        std::string value;
+        if (!file || !(file >> value) || value == "max") {
+                return -1;
+        }
+        try {
+                return std::stoll(value);
+        } catch (const std::logic_error &) {
+                return -1;
+        }
+}
+
+// MemAvailable of /proc/meminfo in bytes, -1 if unknown
+inline long long meminfo_available()
+{
+        std::ifstream file("/proc/meminfo");
+        std::string line;
+        while (std::getline(file, line)) {
+                std::istringstream ss(line);
+                std::string key;
+                long long kib;
+                if (ss >> key >> kib && key == "MemAvailable:") {
+                        return kib * 1024;
+                }
+        }
+        return -1;
+}
+
+// Bytes the memory cgroup of this process may still allocate, -1 if unlimited or unknown. The
+// cgroup of /proc/self/cgroup is looked up under the v2 and the v1 mount points, and the mount
+// point itself is checked as well, since in a container without cgroup namespace the path from
+// /proc/self/cgroup does not exist.
+inline long long cgroup_available()
+{
+        std::vector<std::pair<std::filesystem::path, std::filesystem::path>> candidates;
+        std::ifstream file("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(file, line)) {
+                // hierarchy-ID:controller-list:cgroup-path
+                const size_t first = line.find(':');
+                const size_t second = line.find(':', first + 1);
+                if (first == std::string::npos || second == std::string::npos) {
+                        continue;
+                }
+                const std::string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+                const std::string path = line.substr(second + 1);
+                if (controllers == ",,") {
+                        const std::filesystem::path dir = "/sys/fs/cgroup" + path;
+                        candidates.emplace_back(dir / "memory.max", dir / "memory.current");
+                } else if (controllers.find(",memory,") != std::string::npos) {
+                        const std::filesystem::path dir = "/sys/fs/cgroup/memory" + path;
+                        candidates.emplace_back(dir / "memory.limit_in_bytes", dir / "memory.usage_in_bytes");
+                }
+        }
+        candidates.emplace_back("/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current");
+        candidates.emplace_back("/sys/fs/cgroup/memory/memory.limit_in_bytes", "/sys/fs/cgroup/memory/memory.usage_in_bytes");
+
+        long long available = -1;
+        for (const auto &[limit, usage] : candidates) {
+                const long long max = read_cgroup_value(limit);
+                const long long current = read_cgroup_value(usage);
+                if (max < 0 || max >= CGROUP_UNLIMITED || current < 0) {
+                        continue;
+                }
+                const long long left = std::max(max - current, 0LL);
+                available = available < 0 ? left : std::min(available, left);
+        }
+        return available;
+}
+
+// Bytes this process may still allocate, the smaller of MemAvailable and the cgroup limit, -1 if
+// both are unknown
+inline long long available_memory()
+{
+        const long long meminfo = meminfo_available();
+        const long long cgroup = cgroup_available();
+        if (meminfo < 0 || cgroup < 0) {
+                return std::max(meminfo, cgroup);
+        }
+        return std::min(meminfo, cgroup);
+}
+
+// Preflight of a rooted collective. Every process needs its fixed bytes, root also the bytes of its
+// buffer of the whole distribution, which can be split into rounds. Returns the fewest rounds so
+// that the buffers of all processes of a node fit into the budget of its available memory, the
+// same on all processes. Aborts if the fixed bytes alone exceed the budget of a node.
+inline int plan_rounds(const long long fixed, const long long segmentable, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        MPI_Comm node;
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+        int node_rank;
+        MPI_Comm_rank(node, &node_rank);
+
+        long long bytes[2] = {fixed, segmentable};
+        MPI_Allreduce(MPI_IN_PLACE, bytes, 2, MPI_LONG_LONG, MPI_SUM, node);
+        MPI_Comm_free(&node);
+
+        long long rounds = 1;
+        if (node_rank == 0) {
+                const long long available = available_memory();
+                const auto budget = static_cast<long long>(static_cast<double>(available) * MEMORY_BUDGET);
+                if (available >= 0 && bytes[0] + bytes[1] > budget) {
+                        if (bytes[0] >= budget) {
+                                char name[MPI_MAX_PROCESSOR_NAME];
+                                int length;
+                                MPI_Get_processor_name(name, &length);
+                                // @formatter:off
+                                std::cerr << "ERROR: Buffers on " << name << " need "
+                                          << bytes[0] + bytes[1] << " bytes, but only "
+                                          << budget << " bytes of memory are available" << std::endl;
+                                // @formatter:on
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                        rounds = (bytes[1] + budget - bytes[0] - 1) / (budget - bytes[0]);
+                }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_LONG_LONG, MPI_MAX, comm);
+        return static_cast<int>(std::min<long long>(rounds, INT_MAX));
+}
+
+// Whether the bytes of all processes of a node fit into the budget of its available memory, the
+// same answer on all processes. Unknown memory is assumed to suffice.
+inline bool fits_in_memory(const long long bytes, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        MPI_Comm node;
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+        int node_rank;
+        MPI_Comm_rank(node, &node_rank);
+
+        long long sum = bytes;
+        MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_LONG_LONG, MPI_SUM, node);
+        MPI_Comm_free(&node);
+
+        bool fits = true;
+        if (node_rank == 0) {
+                const long long available = available_memory();
+                fits = available < 0 || static_cast<double>(sum) <= static_cast<double>(available) * MEMORY_BUDGET;
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &fits, 1, MPI_C_BOOL, MPI_LAND, comm);
+        return fits;
+}
+
+// Samples of bytes_per_sample bytes that every process can still keep in memory, the budget of
+// the available memory of a node split evenly between its processes. The same on all processes,
+// LLONG_MAX if the available memory is unknown.
+inline long long affordable_samples(const long long bytes_per_sample, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        MPI_Comm node;
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+        int node_rank, node_size;
+        MPI_Comm_rank(node, &node_rank);
+        MPI_Comm_size(node, &node_size);
+        MPI_Comm_free(&node);
+
+        long long samples = LLONG_MAX;
+        if (node_rank == 0) {
+                const long long available = available_memory();
+                if (available >= 0) {
+                        const double budget = static_cast<double>(available) * MEMORY_BUDGET / node_size;
+                        samples = std::max(static_cast<long long>(budget / static_cast<double>(bytes_per_sample)), 1LL);
+                }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &samples, 1, MPI_LONG_LONG, MPI_MIN, comm);
+        return samples;
+}
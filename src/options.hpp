@@ -0,0 +1,328 @@
+#pragma once
+
+#include <filesystem>
+#include <getopt.h>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include <mpi.h>
+
+#include "histogram.hpp"
+#include "largecount.hpp"
+#include "persistent.hpp"
+#include "timer.hpp"
+
+enum class OutputMode {
+        // Root receives every rank's timestamps and writes CSV
+        csv,
+        // Every rank writes its own fixed-width CSV slab with collective MPI-IO
+        parallel_csv,
+        // Every rank writes its own columns of the binary result format with collective MPI-IO
+        parallel_binary,
+};
+
+enum class Mode {
+        // Time the blocking collective
+        blocking,
+        // Post the non-blocking collective, compute and wait, see overlap.hpp
+        nonblocking,
+        // Start and wait for a persistent collective request created once, see persistent.hpp
+        persistent,
+};
+
+struct Options {
+        std::string collective;
+        std::string fmessages = "default_messages.txt";
+        std::string foutput = "default_output.txt";
+        // Datatype of every pair of processes, only used by alltoallw
+        std::string ftypes;
+        // Call the MPI_Count variant of the collective, used by scatterv, gatherv, allgatherv and
+        // alltoallv
+        bool large_count = false;
+        // Rounds that the root buffer of scatterv and gatherv is split into, 0 picks the fewest
+        // that fit into the available memory, see memory.hpp
+        int segments = 0;
+        // Back the buffer of the whole distribution with one small memfd region mapped over and
+        // over, see synthetic.hpp
+        bool synthetic = false;
+        // In-tree algorithm of the collective, empty for the MPI library's own, see each benchmark
+        std::string algorithm;
+        double timeout = 10.0;
+        bool verbose = false;
+        std::string dtype = "double";
+        OutputMode output_mode = OutputMode::csv;
+        bool stream = false;
+        bool clock_sync = true;
+        // Seconds between the synchronized starts of two iterations, 0 starts right away
+        double window = 0.0;
+        // Excluded from the statistics, run before the calibration
+        long long warmup_iterations = 0;
+        double warmup_seconds = 0.0;
+        // Stop once the 95% confidence interval of the percentile is within +- precision relative
+        // to its value on every process, 0 only stops at the timeout
+        double precision = 0.0;
+        double percentile = 50.0;
+        Mode mode = Mode::blocking;
+        // Seconds of computation between post and wait, 0 matches the blocking latency
+        double compute = 0.0;
+        // Calibrated at startup, see parse_options
+        Timer timer;
+
+        // Name of the message distribution, the file name without extension
+        [[nodiscard]] std::string distribution() const
+        {
+                return std::filesystem::path(fmessages).stem().string();
+        }
+};
+
+// Initialize MPI for the stream writer thread (see stream.hpp), which never calls MPI itself
+inline void init_mpi(int &argc, char **&argv)
+{
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+        if (provided < MPI_THREAD_FUNNELED) {
+                std::cerr << "ERROR: MPI does not provide MPI_THREAD_FUNNELED" << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+}
+
+// Parse the options shared by all benchmarks. Returns an exit code if the program should stop,
+// e.g. after printing the help message, and nothing otherwise. Must be called after init_mpi.
+inline std::optional<int> parse_options(int argc, char *argv[], const std::string &collective, Options &options)
+{
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+        options.collective = collective;
+
+        const option long_options[] = {{"help", no_argument, nullptr, 'h'},
+                                       {"fmessages", required_argument, nullptr, 'm'},
+                                       {"foutput", required_argument, nullptr, 'o'},
+                                       {"timeout", required_argument, nullptr, 't'},
+                                       {"verbose", no_argument, nullptr, 'v'},
+                                       {"dtype", required_argument, nullptr, 'd'},
+                                       {"format", required_argument, nullptr, 'f'},
+                                       {"parallel-io", no_argument, nullptr, 'p'},
+                                       {"stream", no_argument, nullptr, 's'},
+                                       {"no-clock-sync", no_argument, nullptr, 'C'},
+                                       {"window", required_argument, nullptr, 'w'},
+                                       {"timer", required_argument, nullptr, 'T'},
+                                       {"warmup", required_argument, nullptr, 'W'},
+                                       {"precision", required_argument, nullptr, 'E'},
+                                       {"percentile", required_argument, nullptr, 'P'},
+                                       {"mode", required_argument, nullptr, 'M'},
+                                       {"compute", required_argument, nullptr, 'c'},
+                                       {"ftypes", required_argument, nullptr, 'y'},
+                                       {"large-count", no_argument, nullptr, 'L'},
+                                       {"algorithm", required_argument, nullptr, 'a'},
+                                       {"segments", required_argument, nullptr, 'K'},
+                                       {"synthetic", no_argument, nullptr, 'Z'},
+                                       {nullptr, 0, nullptr, 0}};
+
+        std::string format = "csv";
+        bool parallel_io = false;
+        std::string timer = "wtime";
+        std::string mode = "blocking";
+
+        int opt;
+        while ((opt = getopt_long(argc, argv, "hm:o:t:d:f:psCw:T:W:E:P:M:c:y:La:K:Zv", long_options, nullptr)) != -1) {
+                switch (opt) {
+                case 'h':
+                        // @formatter:off
+                        if (rank == 0) {
+                                std::cout << "Help: This program runs a MPI " << collective << "\n"
+                                          << "Options:\n"
+                                          << "  -h, --help            Show this help message\n"
+                                          << "  -m, --fmessages FILE  Specify file with messages (default: default_messages.txt)\n"
+                                          << "  -o, --foutput FILE    Specify output file (default: default_output.txt)\n"
+                                          << "  -t, --timeout NUM     Specify timeout value in seconds (default: 10)\n"
+                                          << "  -d, --dtype TYPE      Specify char for MPI_CHAR, double MPI_DOUBLE or int for MPI_INT32 (default: double)\n"
+                                          << "  -f, --format FORMAT   Specify csv or binary (see bin2csv) output, binary implies --parallel-io (default: csv)\n"
+                                          << "  -p, --parallel-io     Every process writes its own part of the output with MPI-IO\n"
+                                          << "  -s, --stream          Every process streams compressed latencies to its own file while running\n"
+                                          << "  -C, --no-clock-sync   Keep local timestamps instead of mapping them to the clock of rank 0\n"
+                                          << "  -w, --window SECONDS  Start iteration i of all processes at global time start + i * SECONDS\n"
+                                          << "  -T, --timer TIMER     Specify wtime for MPI_Wtime, monotonic for CLOCK_MONOTONIC_RAW or tsc (default: wtime)\n"
+                                          << "  -W, --warmup NUM[s]   Run NUM iterations, or NUM seconds with suffix s, before measuring (default: 0)\n"
+                                          << "  -E, --precision REL   Stop early once the percentile is known to within +- REL, e.g. 0.01 (default: off)\n"
+                                          << "  -P, --percentile P    Specify the percentile that --precision applies to (default: 50)\n"
+                                          << "  -M, --mode MODE       Specify blocking, nonblocking or persistent collectives (default: blocking)\n"
+                                          << "  -c, --compute SECONDS Computation between post and wait in nonblocking mode (default: blocking latency)\n"
+                                          << "  -y, --ftypes FILE     Specify file with the datatype of every pair of processes (alltoallw only)\n"
+                                          << "  -L, --large-count     Use the MPI_Count variant of the collective (v-collectives only)\n"
+                                          << "  -a, --algorithm NAME  Specify an in-tree algorithm of the collective, see README (default: library)\n"
+                                          << "  -K, --segments N      Split the root buffer into N rounds, 0 if it exceeds memory (scatterv and gatherv only, default: 0)\n"
+                                          << "  -Z, --synthetic       Map one small memory region over the buffer of the whole distribution (scatterv and allgatherv only)\n"
+                                          << "  -v, --verbose         Enable verbose mode\n";
+                        }
+                        // @formatter:on
+                        return EXIT_SUCCESS;
+                case 'm':
+                        options.fmessages = optarg;
+                        break;
+                case 'o':
+                        options.foutput = optarg;
+                        break;
+                case 'd':
+                        options.dtype = optarg;
+                        break;
+                case 'f':
+                        format = optarg;
+                        break;
+                case 'p':
+                        parallel_io = true;
+                        break;
+                case 's':
+                        options.stream = true;
+                        break;
+                case 'C':
+                        options.clock_sync = false;
+                        break;
+                case 'w':
+                        options.window = std::stod(optarg);
+                        break;
+                case 'T':
+                        timer = optarg;
+                        break;
+                case 'W': {
+                        const std::string warmup = optarg;
+                        if (!warmup.empty() && warmup.back() == 's') {
+                                options.warmup_seconds = std::stod(warmup.substr(0, warmup.size() - 1));
+                        } else {
+                                options.warmup_iterations = std::stoll(warmup);
+                        }
+                        break;
+                }
+                case 'E':
+                        options.precision = std::stod(optarg);
+                        break;
+                case 'P':
+                        options.percentile = std::stod(optarg);
+                        break;
+                case 'M':
+                        mode = optarg;
+                        break;
+                case 'c':
+                        options.compute = std::stod(optarg);
+                        break;
+                case 'y':
+                        options.ftypes = optarg;
+                        break;
+                case 'L':
+                        options.large_count = true;
+                        break;
+                case 'a':
+                        options.algorithm = optarg;
+                        break;
+                case 'K':
+                        options.segments = std::stoi(optarg);
+                        break;
+                case 'Z':
+                        options.synthetic = true;
+                        break;
+                case 'v':
+                        options.verbose = true;
+                        break;
+                case 't':
+                        options.timeout = std::stod(optarg);
+                        break;
+                default:
+                        if (rank == 0) {
+                                std::cerr << "Unknown option" << std::endl;
+                        }
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (format == "csv") {
+                options.output_mode = parallel_io ? OutputMode::parallel_csv : OutputMode::csv;
+        } else if (format == "binary") {
+                options.output_mode = OutputMode::parallel_binary;
+        } else {
+                if (rank == 0) {
+                        std::cerr << "Unknown format option: " << format << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+
+        if (mode == "blocking") {
+                options.mode = Mode::blocking;
+        } else if (mode == "nonblocking") {
+                options.mode = Mode::nonblocking;
+        } else if (mode == "persistent" && PERSISTENT_COLLECTIVES) {
+                options.mode = Mode::persistent;
+        } else if (mode == "persistent") {
+                if (rank == 0) {
+                        std::cerr << "MPI library lacks persistent collectives" << std::endl;
+                }
+                return EXIT_FAILURE;
+        } else {
+                if (rank == 0) {
+                        std::cerr << "Unknown mode option: " << mode << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+
+        if (options.large_count && !LARGE_COUNT_COLLECTIVES && options.mode != Mode::blocking) {
+                if (rank == 0) {
+                        std::cerr << "MPI library lacks large-count collectives, they are only emulated in blocking mode" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+
+        if (options.segments < 0) {
+                if (rank == 0) {
+                        std::cerr << "Number of segments must not be negative" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+
+        if (options.percentile <= 0.0 || options.percentile >= 100.0) {
+                if (rank == 0) {
+                        std::cerr << "Percentile must be between 0 and 100" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+        if (options.precision > 0.0 && options.precision < HISTOGRAM_RESOLUTION) {
+                if (rank == 0) {
+                        std::cerr << "Precision must be at least " << HISTOGRAM_RESOLUTION
+                                  << ", the resolution of the latency histogram" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+        if (options.precision > 0.0 && options.window > 0.0) {
+                if (rank == 0) {
+                        std::cerr << "Option --precision cannot be combined with --window" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+
+        const std::optional<TimerKind> kind = parse_timer(timer);
+        if (!kind) {
+                if (rank == 0) {
+                        std::cerr << "Unknown timer option: " << timer << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+        const std::optional<Timer> calibrated = Timer::calibrate(*kind);
+        // All processes have to agree, otherwise only some of them would stop
+        bool available = calibrated.has_value();
+        MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+        if (!available) {
+                if (rank == 0) {
+                        std::cerr << "Timer " << timer << " is not available, the CPU has no invariant TSC" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+        options.timer = *calibrated;
+
+        if (options.window > 0.0 && !options.clock_sync) {
+                if (rank == 0) {
+                        std::cerr << "Option --window requires synchronized clocks" << std::endl;
+                }
+                return EXIT_FAILURE;
+        }
+
+        return std::nullopt;
+}
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <mpi.h>
+
+#include "arena.hpp"
+#include "format.hpp"
+#include "timer.hpp"
+
+// Largest number of bytes passed to a single MPI_File_write_at_all
+constexpr size_t MPIIO_CHUNK_SIZE = 1 << 30;
+
+// Largest number of doubles passed to a single MPI_Send or MPI_Recv
+constexpr size_t SEND_CHUNK_SIZE = INT_MAX;
+
+// Number of characters of n printed as decimal
+inline int decimal_width(unsigned long long n)
+{
+        int width = 1;
+        while (n >= 10) {
+                n /= 10;
+                ++width;
+        }
+        return width;
+}
+
+// Write buffer at offset with as many collective calls as the largest buffer on any process needs
+inline void write_at_all_chunked(const MPI_File fh, const MPI_Offset offset, const char *buffer, const size_t bytes, const MPI_Comm comm)
+{
+        unsigned long long rounds = (bytes + MPIIO_CHUNK_SIZE - 1) / MPIIO_CHUNK_SIZE;
+        MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+
+        for (unsigned long long i = 0; i < rounds; ++i) {
+                const size_t begin = std::min<size_t>(i * MPIIO_CHUNK_SIZE, bytes);
+                const size_t count = std::min<size_t>(MPIIO_CHUNK_SIZE, bytes - begin);
+                MPI_File_write_at_all(fh,
+                                      offset + static_cast<MPI_Offset>(begin),
+                                      buffer + begin,
+                                      static_cast<int>(count),
+                                      MPI_CHAR,
+                                      MPI_STATUS_IGNORE);
+        }
+}
+
+// Root receives the timestamps of every other process one after another and writes them as CSV
+inline void write_csv(const std::string &filename, const TimestampArena &times, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        const size_t iter = times.size();
+        const size_t count = 2 * iter;
+
+        if (rank == 0) {
+                std::ofstream out_file(filename);
+                if (!out_file) {
+                        std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                out_file.seekp(0, std::ios::end);
+                if (out_file.tellp() == 0) {
+                        out_file << "Rank,Iteration,Starttime,Endtime\n";
+                        out_file.flush();
+                }
+                for (size_t i = 0; i < iter; ++i) {
+                        out_file << rank << ","
+                                 << i << ","
+                                 << std::fixed << std::setprecision(8) << times.start(i) << ","
+                                 << std::fixed << std::setprecision(8) << times.stop(i) << "\n";
+                }
+
+                for (int r = 1; r < csize; ++r) {
+                        std::vector<double> recv_vec_times(count);
+                        for (size_t begin = 0; begin < count; begin += SEND_CHUNK_SIZE) {
+                                MPI_Recv(recv_vec_times.data() + begin,
+                                         static_cast<int>(std::min(SEND_CHUNK_SIZE, count - begin)),
+                                         MPI_DOUBLE,
+                                         r,
+                                         0,
+                                         comm,
+                                         MPI_STATUS_IGNORE);
+                        }
+
+                        for (size_t i = 0; i < iter; ++i) {
+                                out_file << r << ","
+                                         << i << ","
+                                         << std::fixed << std::setprecision(8) << recv_vec_times[2 * i] << ","
+                                         << std::fixed << std::setprecision(8) << recv_vec_times[2 * i + 1] << "\n";
+                        }
+                }
+                out_file.close();
+        } else {
+                // Arena is a contiguous memory block, sent in chunks that fit the int count
+                for (size_t begin = 0; begin < count; begin += SEND_CHUNK_SIZE) {
+                        MPI_Send(times.data() + begin,
+                                 static_cast<int>(std::min(SEND_CHUNK_SIZE, count - begin)),
+                                 MPI_DOUBLE,
+                                 0,
+                                 0,
+                                 comm);
+                }
+        }
+}
+
+inline MPI_File open_truncated(const std::string &filename, const MPI_Comm comm)
+{
+        MPI_File fh;
+        const int err = MPI_File_open(comm,
+                                      filename.c_str(),
+                                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                                      MPI_INFO_NULL,
+                                      &fh);
+        if (err != MPI_SUCCESS) {
+                std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        MPI_File_set_size(fh, 0);
+        return fh;
+}
+
+// Every process writes its samples as fixed-width CSV rows to a precomputed offset. Columns are
+// padded with spaces to the widest value over all processes so that the offset of each slab
+// only depends on the number of samples before it.
+inline void write_csv_mpiio(const std::string &filename, const TimestampArena &times, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        const size_t n = times.size();
+
+        // Widest timestamp decides the width of both time columns
+        char tmp[64];
+        int time_width = 0;
+        for (size_t i = 0; i < 2 * n; ++i) {
+                const auto res = std::to_chars(tmp, tmp + sizeof(tmp), times.data()[i], std::chars_format::fixed, 8);
+                time_width = std::max(time_width, static_cast<int>(res.ptr - tmp));
+        }
+        unsigned long long max_n = n;
+        MPI_Allreduce(MPI_IN_PLACE, &time_width, 1, MPI_INT, MPI_MAX, comm);
+        MPI_Allreduce(MPI_IN_PLACE, &max_n, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+
+        const int rank_width = decimal_width(csize - 1);
+        const int iter_width = decimal_width(max_n > 0 ? max_n - 1 : 0);
+        const size_t row_width = rank_width + iter_width + 2 * time_width + 4;
+
+        const std::string header = "Rank,Iteration,Starttime,Endtime\n";
+        const size_t header_bytes = rank == 0 ? header.size() : 0;
+
+        std::vector<char> buffer(header_bytes + n * row_width, ' ');
+        if (rank == 0) {
+                std::memcpy(buffer.data(), header.data(), header.size());
+        }
+
+        // Right-align value in a field of width characters ending in sep
+        auto put = [&](char *field, const int width, auto value, const char sep)
+        {
+                std::to_chars_result res;
+                if constexpr (std::is_floating_point_v<decltype(value)>) {
+                        res = std::to_chars(tmp, tmp + sizeof(tmp), value, std::chars_format::fixed, 8);
+                } else {
+                        res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+                }
+                const auto len = static_cast<int>(res.ptr - tmp);
+                std::memcpy(field + width - len, tmp, len);
+                field[width] = sep;
+        };
+
+        for (size_t i = 0; i < n; ++i) {
+                char *row = buffer.data() + header_bytes + i * row_width;
+                put(row, rank_width, rank, ',');
+                row += rank_width + 1;
+                put(row, iter_width, i, ',');
+                row += iter_width + 1;
+                put(row, time_width, times.start(i), ',');
+                row += time_width + 1;
+                put(row, time_width, times.stop(i), '\n');
+        }
+
+        unsigned long long bytes = buffer.size();
+        unsigned long long offset = 0;
+        MPI_Exscan(&bytes, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+        if (rank == 0) {
+                offset = 0;
+        }
+
+        MPI_File fh = open_truncated(filename, comm);
+        write_at_all_chunked(fh, static_cast<MPI_Offset>(offset), buffer.data(), buffer.size(), comm);
+        MPI_File_close(&fh);
+}
+
+// Store the encoded values of one column with delta_size bytes each
+inline std::vector<char> pack_column(const std::vector<uint64_t> &values, const uint32_t delta_size)
+{
+        std::vector<char> buffer(values.size() * delta_size);
+        for (size_t i = 0; i < values.size(); ++i) {
+                if (delta_size == sizeof(uint32_t)) {
+                        const auto v = static_cast<uint32_t>(values[i]);
+                        std::memcpy(buffer.data() + i * delta_size, &v, delta_size);
+                } else {
+                        std::memcpy(buffer.data() + i * delta_size, &values[i], delta_size);
+                }
+        }
+        return buffer;
+}
+
+// Every process encodes its samples as start deltas and durations (see format.hpp) and writes
+// its part of each column with collective MPI-IO. Root writes the header.
+inline void write_results_mpiio(const std::string &filename,
+                                const TimestampArena &times,
+                                const std::string &collective,
+                                const std::string &distribution,
+                                const std::string &dtype,
+                                const Timer &timer,
+                                const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        const uint64_t n = times.size();
+        uint64_t min_n = n, max_n = n;
+        MPI_Allreduce(MPI_IN_PLACE, &min_n, 1, MPI_UINT64_T, MPI_MIN, comm);
+        MPI_Allreduce(MPI_IN_PLACE, &max_n, 1, MPI_UINT64_T, MPI_MAX, comm);
+        if (min_n != max_n) {
+                if (rank == 0) {
+                        std::cerr << "ERROR: Binary output requires the same number of iterations on every process"
+                                  << std::endl;
+                }
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        const double base = n > 0 ? times.start(0) : 0.0;
+        std::vector<uint64_t> start_delta(n);
+        std::vector<uint64_t> duration(n);
+        uint64_t max_ticks = 0;
+        int64_t previous = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+                const int64_t start = to_ticks(times.start(i), base);
+                const int64_t stop = to_ticks(times.stop(i), base);
+                start_delta[i] = static_cast<uint64_t>(std::max<int64_t>(start - previous, 0));
+                duration[i] = static_cast<uint64_t>(std::max<int64_t>(stop - start, 0));
+                max_ticks = std::max({max_ticks, start_delta[i], duration[i]});
+                previous = start;
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &max_ticks, 1, MPI_UINT64_T, MPI_MAX, comm);
+        double timer_stats[2] = {timer.resolution, timer.overhead};
+        MPI_Allreduce(MPI_IN_PLACE, timer_stats, 2, MPI_DOUBLE, MPI_MAX, comm);
+        const uint32_t delta_size = max_ticks <= UINT32_MAX ? sizeof(uint32_t) : sizeof(uint64_t);
+
+        ResultHeader header = make_result_header(csize, n, delta_size);
+        if (rank == 0) {
+                char library[MPI_MAX_LIBRARY_VERSION_STRING];
+                int len;
+                MPI_Get_library_version(library, &len);
+                std::string version(library, len);
+                version.erase(version.find_last_not_of(" \n\r\t") + 1);
+
+                set_field(header.collective, collective);
+                set_field(header.distribution, distribution);
+                set_field(header.dtype, dtype);
+                set_field(header.timer, timer_name(timer.kind));
+                header.timer_resolution = timer_stats[0];
+                header.timer_overhead = timer_stats[1];
+                set_field(header.mpi_library, version);
+        }
+
+        const std::vector<char> starts = pack_column(start_delta, delta_size);
+        const std::vector<char> durations = pack_column(duration, delta_size);
+
+        MPI_File fh = open_truncated(filename, comm);
+        write_at_all_chunked(fh, 0, reinterpret_cast<const char *>(&header), rank == 0 ? sizeof(header) : 0, comm);
+        write_at_all_chunked(fh,
+                             static_cast<MPI_Offset>(header.header_size + rank * sizeof(double)),
+                             reinterpret_cast<const char *>(&base),
+                             sizeof(double),
+                             comm);
+        write_at_all_chunked(fh,
+                             static_cast<MPI_Offset>(result_column_offset(header, 0, rank)),
+                             starts.data(),
+                             starts.size(),
+                             comm);
+        write_at_all_chunked(fh,
+                             static_cast<MPI_Offset>(result_column_offset(header, 1, rank)),
+                             durations.data(),
+                             durations.size(),
+                             comm);
+        MPI_File_close(&fh);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <mpi.h>
+
+#include "options.hpp"
+#include "timing.hpp"
+
+// Share of the time budget spent on measuring the blocking collective as reference
+constexpr double BASELINE_FRACTION = 0.1;
+// Kernel steps timed to estimate the speed of the compute kernel
+constexpr long long KERNEL_CALIBRATION_STEPS = 1 << 20;
+
+// Synthetic compute kernel between posting a non-blocking collective and waiting for it. A chain
+// of dependent floating point operations keeps the core busy without touching memory, so the
+// MPI library only progresses the collective if it does so asynchronously.
+class ComputeKernel {
+        long long steps = 0;
+
+public:
+        // Wall time of one run in seconds, as calibrated
+        double seconds = 0.0;
+
+        void run() const noexcept
+        {
+                double x = 1.0;
+                for (long long i = 0; i < steps; ++i) {
+                        x = x * 0.999999 + 1e-6;
+                }
+                // Keep the chain from being optimized away
+                volatile double sink = x;
+                static_cast<void>(sink);
+        }
+
+        // Number of steps that take seconds on the slowest process, so that all processes compute
+        // for the same number of steps
+        static ComputeKernel calibrate(const double seconds, const MPI_Comm comm = MPI_COMM_WORLD)
+        {
+                ComputeKernel kernel;
+                kernel.steps = KERNEL_CALIBRATION_STEPS;
+                const double t_start = MPI_Wtime();
+                kernel.run();
+                double per_step = (MPI_Wtime() - t_start) / static_cast<double>(KERNEL_CALIBRATION_STEPS);
+                MPI_Allreduce(MPI_IN_PLACE, &per_step, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+                kernel.steps = static_cast<long long>(seconds / std::max(per_step, 1e-12));
+                kernel.seconds = static_cast<double>(kernel.steps) * per_step;
+                return kernel;
+        }
+};
+
+// Mean latency of the blocking collective in seconds over all processes, measured for a share of
+// the time budget. This is the reference for the overlap ratio and the default compute time.
+template <typename F>
+double blocking_baseline(F &&op, const Options &options, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int csize;
+        MPI_Comm_size(comm, &csize);
+
+        const Timer &timer = options.timer;
+        const double max_seconds = std::max(options.timeout * BASELINE_FRACTION, 1e-3);
+        const long long iterations = calibrate_iterations(op, max_seconds, comm);
+
+        double elapsed = 0.0;
+        MPI_Barrier(comm);
+        for (long long i = 0; i < iterations; ++i) {
+                const double t_start = timer.start();
+                op();
+                elapsed += std::max(timer.stop() - timer.overhead - t_start, 0.0);
+        }
+        MPI_Barrier(comm);
+
+        double mean = elapsed / static_cast<double>(iterations);
+        MPI_Allreduce(MPI_IN_PLACE, &mean, 1, MPI_DOUBLE, MPI_SUM, comm);
+        return mean / csize;
+}
+
+// Fraction of the blocking latency that was hidden behind the compute kernel. Post and wait of a
+// perfectly overlapped collective cost nothing, without any overlap they cost as much as the
+// blocking collective.
+inline double overlap_ratio(const double blocking, const double post_wait)
+{
+        if (blocking <= 0.0) {
+                return 0.0;
+        }
+        return std::clamp(1.0 - post_wait / blocking, 0.0, 1.0);
+}
+
+inline void print_overlap(const double blocking, const double compute, const double post_wait)
+{
+        // @formatter:off
+        std::ostringstream oss;
+        oss << std::left << std::setw(25) << "Blocking Latency (μs)"
+                         << std::setw(25) << "Compute (μs)"
+                         << std::setw(25) << "Post+Wait Latency (μs)"
+                         << std::setw(20) << "Overlap (%)"
+                         << std::endl
+                         << std::setw(25) << blocking * 1e6
+                         << std::setw(25) << compute * 1e6
+                         << std::setw(25) << post_wait * 1e6
+                         << std::setw(20) << overlap_ratio(blocking, post_wait) * 100.0
+                         << std::endl;
+        std::cout << oss.str() << std::endl;
+        // @formatter:on
+}
+
+// Post a non-blocking collective, run the kernel and wait for the collective. Returns the time
+// spent in post and wait, without the computation in between.
+template <typename Post>
+double post_compute_wait(Post &&post, const ComputeKernel &kernel, const Timer &timer)
+{
+        MPI_Request request;
+        const double t_post = timer.start();
+        post(&request);
+        const double posted = timer.stop();
+
+        kernel.run();
+
+        const double t_wait = timer.start();
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        const double waited = timer.stop();
+        return std::max(posted - t_post + waited - t_wait - 2.0 * timer.overhead, 0.0);
+}
@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "matrix.hpp"
+#include "options.hpp"
+#include "report.hpp"
+#include "timing.hpp"
+
+// Tags of the payload and of the acknowledgement that closes a window
+constexpr int P2P_TAG = 7301;
+constexpr int P2P_ACK_TAG = 7302;
+// Messages in flight per pair and direction in the streaming tests, as many as fit into
+// P2P_WINDOW_BYTES for large messages
+constexpr int P2P_WINDOW = 64;
+constexpr size_t P2P_WINDOW_BYTES = 64 << 20;
+
+enum class P2PTest {
+        // Ping-pong between the first pair, half the round trip
+        latency,
+        // Window of sends from the first to the second process of the first pair, acknowledged
+        // once the whole window arrived
+        bandwidth,
+        // Windows in both directions of the first pair at the same time
+        bibandwidth,
+        // Windows of every pair at the same time, the aggregate number of messages per second
+        message_rate,
+};
+
+inline std::optional<P2PTest> parse_p2p_test(const std::string &name)
+{
+        if (name == "latency") {
+                return P2PTest::latency;
+        }
+        if (name == "bandwidth") {
+                return P2PTest::bandwidth;
+        }
+        if (name == "bibandwidth") {
+                return P2PTest::bibandwidth;
+        }
+        if (name == "message-rate") {
+                return P2PTest::message_rate;
+        }
+        return std::nullopt;
+}
+
+// One point of a curve, latencies are per message in seconds, from the merged histograms of
+// every process taking part, bandwidth and message rate are the aggregate of all pairs
+struct RatePoint {
+        std::string test;
+        size_t bytes;
+        LatencySummary latency;
+        double bandwidth;
+        double message_rate;
+};
+
+// Process i is paired with process i + csize / 2, the last one idles for an odd number of
+// processes. The first pair is ranks 0 and csize / 2, so with ranks placed by node it crosses
+// the network.
+template <typename T>
+class P2P {
+        int rank{};
+        int csize{};
+        int pairs{};
+        std::vector<T> sbuffer;
+        std::vector<T> rbuffer;
+        std::vector<MPI_Request> requests;
+        std::vector<RatePoint> curve;
+
+        TimestampArena times;
+        LatencyHistogram histogram;
+
+        static MPI_Datatype get_mpi_type() {
+                if constexpr (std::is_same_v<T, int>) {
+                        return MPI_INT;
+                } else if constexpr (std::is_same_v<T, double>) {
+                        return MPI_DOUBLE;
+                } else if constexpr (std::is_same_v<T, char>) {
+                        return MPI_CHAR;
+                }
+                return MPI_DATATYPE_NULL;
+        }
+
+        [[nodiscard]] int peer() const
+        {
+                return rank < pairs ? rank + pairs : rank - pairs;
+        }
+
+        static int window(const int msg_size)
+        {
+                const size_t bytes = std::max<size_t>(msg_size * sizeof(T), 1);
+                return static_cast<int>(std::clamp<size_t>(P2P_WINDOW_BYTES / bytes, 1, P2P_WINDOW));
+        }
+
+        // Prepare one send buffer and a receive slot for every message of a window
+        void setup(const int msg_size)
+        {
+                try {
+                        const size_t slots = static_cast<size_t>(window(msg_size)) * msg_size;
+                        sbuffer.resize(msg_size);
+                        rbuffer.resize(std::max(rbuffer.size(), slots));
+                        requests.resize(2 * P2P_WINDOW);
+                } catch (const std::bad_alloc &e) {
+                        std::cerr << "ERROR: Could not allocate memory [rank " << rank << "]: " << e.what() << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
+        // Post a window of sends and/or receives and wait for all of them
+        void stream_window(const int msg_size, const int count, const bool send, const bool receive)
+        {
+                int posted = 0;
+                if (receive) {
+                        for (int i = 0; i < count; ++i) {
+                                MPI_Irecv(rbuffer.data() + static_cast<size_t>(i) * msg_size,
+                                          msg_size,
+                                          get_mpi_type(),
+                                          peer(),
+                                          P2P_TAG,
+                                          MPI_COMM_WORLD,
+                                          &requests[posted++]);
+                        }
+                }
+                if (send) {
+                        for (int i = 0; i < count; ++i) {
+                                MPI_Isend(sbuffer.data(), msg_size, get_mpi_type(), peer(), P2P_TAG, MPI_COMM_WORLD, &requests[posted++]);
+                        }
+                }
+                MPI_Waitall(posted, requests.data(), MPI_STATUSES_IGNORE);
+        }
+
+        // One iteration of test on a process taking part, messages go through MPI_COMM_WORLD
+        void iteration(const P2PTest test, const int msg_size)
+        {
+                const bool sender = rank < pairs;
+                const int count = window(msg_size);
+                switch (test) {
+                case P2PTest::latency:
+                        if (sender) {
+                                MPI_Send(sbuffer.data(), msg_size, get_mpi_type(), peer(), P2P_TAG, MPI_COMM_WORLD);
+                                MPI_Recv(rbuffer.data(), msg_size, get_mpi_type(), peer(), P2P_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                        } else {
+                                MPI_Recv(rbuffer.data(), msg_size, get_mpi_type(), peer(), P2P_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                                MPI_Send(sbuffer.data(), msg_size, get_mpi_type(), peer(), P2P_TAG, MPI_COMM_WORLD);
+                        }
+                        break;
+                case P2PTest::bandwidth:
+                case P2PTest::message_rate:
+                        stream_window(msg_size, count, sender, !sender);
+                        if (sender) {
+                                MPI_Recv(nullptr, 0, MPI_BYTE, peer(), P2P_ACK_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                        } else {
+                                MPI_Send(nullptr, 0, MPI_BYTE, peer(), P2P_ACK_TAG, MPI_COMM_WORLD);
+                        }
+                        break;
+                case P2PTest::bibandwidth:
+                        stream_window(msg_size, count, true, true);
+                        break;
+                }
+        }
+
+        // Send a known pattern once, outside of the timed iterations, and check every receive slot
+        // on the processes taking part in comm
+        void verify(const P2PTest test, const int msg_size, const MPI_Comm comm)
+        {
+                for (int i = 0; i < msg_size; ++i) {
+                        sbuffer[i] = static_cast<T>(i + 1);
+                }
+                std::fill(rbuffer.begin(), rbuffer.end(), static_cast<T>(0));
+                iteration(test, msg_size);
+
+                int slots = 0;
+                if (test == P2PTest::latency) {
+                        slots = 1;
+                } else if (test == P2PTest::bibandwidth || rank >= pairs) {
+                        slots = window(msg_size);
+                }
+                bool valid = true;
+                for (int slot = 0; slot < slots; ++slot) {
+                        for (int i = 0; i < msg_size; ++i) {
+                                valid = valid && rbuffer[static_cast<size_t>(slot) * msg_size + i] == static_cast<T>(i + 1);
+                        }
+                }
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, comm);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Received payload does not match the send buffer" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
+        // Time one size with the options of the whole run, only the time budget is the share of
+        // this size. Messages only travel between pairs, so there is no clock synchronization and
+        // no barrier between iterations.
+        void run_size(const std::string &name, const P2PTest test, const int msg_size, const Options &options, const double max_seconds)
+        {
+                const bool active = test == P2PTest::message_rate ? rank < 2 * pairs : rank == 0 || rank == pairs;
+                MPI_Comm comm;
+                MPI_Comm_split(MPI_COMM_WORLD, active ? 0 : MPI_UNDEFINED, rank, &comm);
+                if (!active) {
+                        MPI_Barrier(MPI_COMM_WORLD);
+                        return;
+                }
+
+                setup(msg_size);
+                verify(test, msg_size, comm);
+
+                Options sized = options;
+                sized.timeout = max_seconds;
+                sized.clock_sync = false;
+                sized.verbose = false;
+                measure([&]
+                        {
+                                iteration(test, msg_size);
+                        },
+                        sized,
+                        times,
+                        histogram,
+                        comm);
+
+                const LatencyReport report = reduce_latencies(histogram, 0, comm);
+                MPI_Comm_free(&comm);
+
+                if (rank == 0) {
+                        // A round trip carries two messages, a window one message per slot and
+                        // direction at the same time
+                        const double messages = test == P2PTest::latency ? 2.0 : static_cast<double>(window(msg_size));
+                        LatencySummary latency = report.global;
+                        for (double *value : {&latency.avg, &latency.min, &latency.p50, &latency.p99, &latency.p999, &latency.max}) {
+                                *value /= messages;
+                        }
+
+                        // Concurrent one-way streams of messages
+                        double streams = 1.0;
+                        if (test == P2PTest::bibandwidth) {
+                                streams = 2.0;
+                        } else if (test == P2PTest::message_rate) {
+                                streams = pairs;
+                        }
+                        const size_t bytes = msg_size * sizeof(T);
+                        const double rate = latency.avg > 0.0 ? streams / latency.avg : 0.0;
+                        curve.push_back({name, bytes, latency, rate * static_cast<double>(bytes), rate});
+
+                        if (options.verbose) {
+                                // @formatter:off
+                                std::cout << std::left
+                                          << std::setw(25) << name
+                                          << std::setw(25) << bytes
+                                          << std::setw(25) << latency.avg * 1e6
+                                          << std::setw(25) << latency.min * 1e6
+                                          << std::setw(25) << latency.p50 * 1e6
+                                          << std::setw(25) << latency.p99 * 1e6
+                                          << std::setw(25) << latency.max * 1e6
+                                          << std::setw(25) << rate * static_cast<double>(bytes) * 1e-6
+                                          << std::setw(25) << rate * 1e-6
+                                          << std::endl;
+                                // @formatter:on
+                        }
+                }
+                MPI_Barrier(MPI_COMM_WORLD);
+        }
+
+public:
+        P2P()
+        {
+                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+                pairs = csize / 2;
+
+                if (rank == 0 && csize < 2) {
+                        std::cerr << "ERROR: Need more than one process." << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
+        // Sweep powers of two from 1 element up to the largest count in the message file, for one
+        // test or for all of them, with an equal share of the time budget per size
+        void run(const Options &options)
+        {
+                std::vector<std::string> tests = {options.algorithm};
+                if (options.algorithm.empty() || options.algorithm == "all") {
+                        tests = {"latency", "bandwidth", "bibandwidth", "message-rate"};
+                } else if (!parse_p2p_test(options.algorithm)) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Unknown test " << options.algorithm << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                if (options.mode != Mode::blocking) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Point-to-point tests are only available in blocking mode" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                // The output holds one curve, there are no per-iteration timestamps to stream or to
+                // write in parallel, and the pairs do not enter a collective at the same time
+                if (options.stream || options.output_mode != OutputMode::csv || options.window > 0.0 ||
+                    options.large_count || options.synthetic) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Point-to-point tests do not support --stream, --format binary, --parallel-io, "
+                                             "--window, --large-count or --synthetic" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                const size_t max_size = load_max_count(options.fmessages);
+                std::vector<int> sizes;
+                for (size_t size = 1; size <= max_size; size *= 2) {
+                        sizes.push_back(static_cast<int>(size));
+                }
+                const double max_seconds = options.timeout /
+                                           static_cast<double>(sizes.size() * tests.size());
+
+                if (rank == 0 && options.verbose) {
+                        // @formatter:off
+                        std::cout << std::left
+                                  << std::setw(25) << "Test"
+                                  << std::setw(25) << "Size (Bytes)"
+                                  << std::setw(25) << "Avg Latency (μs)"
+                                  << std::setw(25) << "Min Latency (μs)"
+                                  << std::setw(25) << "P50 Latency (μs)"
+                                  << std::setw(25) << "P99 Latency (μs)"
+                                  << std::setw(25) << "Max Latency (μs)"
+                                  << std::setw(25) << "Bandwidth (MB/s)"
+                                  << std::setw(25) << "Message Rate (M/s)"
+                                  << std::endl;
+                        // @formatter:on
+                }
+
+                for (const std::string &test : tests) {
+                        for (const int size : sizes) {
+                                run_size(test, *parse_p2p_test(test), size, options, max_seconds);
+                        }
+                }
+        }
+
+        // Save the curves to file
+        void save_latencies(const std::string &filename, const bool verbose = false) const
+        {
+                if (rank == 0) {
+                        std::ofstream out_file(filename);
+                        if (!out_file) {
+                                std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                        out_file << "Test,Bytes,Avg Latency,Min Latency,P50 Latency,P99 Latency,P99.9 Latency,Max Latency,Bandwidth,Message Rate\n";
+                        for (const RatePoint &point : curve) {
+                                out_file << point.test << ","
+                                         << point.bytes << ","
+                                         << point.latency.avg << ","
+                                         << point.latency.min << ","
+                                         << point.latency.p50 << ","
+                                         << point.latency.p99 << ","
+                                         << point.latency.p999 << ","
+                                         << point.latency.max << ","
+                                         << point.bandwidth << ","
+                                         << point.message_rate << "\n";
+                        }
+                        out_file.close();
+                        if (verbose) {
+                                std::cout << "Latencies saved to " << filename << std::endl;
+                        }
+                }
+        }
+};
+
+int main(int argc, char *argv[])
+{
+        init_mpi(argc, argv);
+
+        Options options;
+        if (const auto status = parse_options(argc, argv, "p2p", options)) {
+                MPI_Finalize();
+                return *status;
+        }
+
+        try {
+                if (options.dtype == "double") {
+                        P2P<double> benchmark;
+                        benchmark.run(options);
+                        benchmark.save_latencies(options.foutput, options.verbose);
+                } else if (options.dtype == "int") {
+                        P2P<int> benchmark;
+                        benchmark.run(options);
+                        benchmark.save_latencies(options.foutput, options.verbose);
+                } else if (options.dtype == "char") {
+                        P2P<char> benchmark;
+                        benchmark.run(options);
+                        benchmark.save_latencies(options.foutput, options.verbose);
+                } else {
+                        std::cerr << "Unknown dtype option: " << options.dtype << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        return EXIT_FAILURE;
+                }
+        } catch (const std::exception &e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                return EXIT_FAILURE;
+        }
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <mpi.h>
+
+#if defined(HAVE_MPIX_PERSISTENT_COLLECTIVES)
+#include <mpi-ext.h>
+#endif
+
+#include "timer.hpp"
+
+// Persistent collectives of MPI 4.0, or the MPIX_ extension of Open MPI 4.x, as detected by CMake
+#if defined(HAVE_MPI_PERSISTENT_COLLECTIVES)
+#define PERSISTENT_COLLECTIVE(name) MPI_##name##_init
+#elif defined(HAVE_MPIX_PERSISTENT_COLLECTIVES)
+#define PERSISTENT_COLLECTIVE(name) MPIX_##name##_init
+#endif
+
+#ifdef PERSISTENT_COLLECTIVE
+constexpr bool PERSISTENT_COLLECTIVES = true;
+#else
+constexpr bool PERSISTENT_COLLECTIVES = false;
+
+[[noreturn]] inline void persistent_unavailable()
+{
+        std::cerr << "ERROR: MPI library lacks persistent collectives" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        std::abort();
+}
+#endif
+
+inline void scatterv_init(const void *sendbuf,
+                          const int sendcounts[],
+                          const int displs[],
+                          const MPI_Datatype sendtype,
+                          void *recvbuf,
+                          const int recvcount,
+                          const MPI_Datatype recvtype,
+                          const int root,
+                          const MPI_Comm comm,
+                          MPI_Request *request)
+{
+#ifdef PERSISTENT_COLLECTIVE
+        PERSISTENT_COLLECTIVE(Scatterv)(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm, MPI_INFO_NULL, request);
+#else
+        persistent_unavailable();
+#endif
+}
+
+inline void gatherv_init(const void *sendbuf,
+                         const int sendcount,
+                         const MPI_Datatype sendtype,
+                         void *recvbuf,
+                         const int recvcounts[],
+                         const int displs[],
+                         const MPI_Datatype recvtype,
+                         const int root,
+                         const MPI_Comm comm,
+                         MPI_Request *request)
+{
+#ifdef PERSISTENT_COLLECTIVE
+        PERSISTENT_COLLECTIVE(Gatherv)(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm, MPI_INFO_NULL, request);
+#else
+        persistent_unavailable();
+#endif
+}
+
+inline void allgatherv_init(const void *sendbuf,
+                            const int sendcount,
+                            const MPI_Datatype sendtype,
+                            void *recvbuf,
+                            const int recvcounts[],
+                            const int displs[],
+                            const MPI_Datatype recvtype,
+                            const MPI_Comm comm,
+                            MPI_Request *request)
+{
+#ifdef PERSISTENT_COLLECTIVE
+        PERSISTENT_COLLECTIVE(Allgatherv)(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm, MPI_INFO_NULL, request);
+#else
+        persistent_unavailable();
+#endif
+}
+
+inline void alltoallv_init(const void *sendbuf,
+                           const int sendcounts[],
+                           const int sdispls[],
+                           const MPI_Datatype sendtype,
+                           void *recvbuf,
+                           const int recvcounts[],
+                           const int rdispls[],
+                           const MPI_Datatype recvtype,
+                           const MPI_Comm comm,
+                           MPI_Request *request)
+{
+#ifdef PERSISTENT_COLLECTIVE
+        PERSISTENT_COLLECTIVE(Alltoallv)(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm, MPI_INFO_NULL, request);
+#else
+        persistent_unavailable();
+#endif
+}
+
+inline void alltoallw_init(const void *sendbuf,
+                           const int sendcounts[],
+                           const int sdispls[],
+                           const MPI_Datatype sendtypes[],
+                           void *recvbuf,
+                           const int recvcounts[],
+                           const int rdispls[],
+                           const MPI_Datatype recvtypes[],
+                           const MPI_Comm comm,
+                           MPI_Request *request)
+{
+#ifdef PERSISTENT_COLLECTIVE
+        PERSISTENT_COLLECTIVE(Alltoallw)(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm, MPI_INFO_NULL, request);
+#else
+        persistent_unavailable();
+#endif
+}
+
+// Create the persistent request with init and return how long that took on this process
+template <typename Init>
+double timed_init(Init &&init, const Timer &timer)
+{
+        const double t_start = timer.start();
+        init();
+        return std::max(timer.stop() - timer.overhead - t_start, 0.0);
+}
+
+// Root prints mean and maximum of the one-time init cost over all processes
+inline void print_init(const double seconds, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        double sum = 0.0, max = 0.0;
+        MPI_Reduce(&seconds, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(&seconds, &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+        if (rank == 0) {
+                // @formatter:off
+                std::ostringstream oss;
+                oss << std::left << std::setw(25) << "Avg Init Latency (μs)"
+                                 << std::setw(25) << "Max Init Latency (μs)"
+                                 << std::endl
+                                 << std::setw(25) << sum / csize * 1e6
+                                 << std::setw(25) << max * 1e6
+                                 << std::endl;
+                std::cout << oss.str() << std::endl;
+                // @formatter:on
+        }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "histogram.hpp"
+
+// Percentiles of one histogram in seconds
+struct LatencySummary {
+        double count = 0.0;
+        double avg = 0.0;
+        double min = 0.0;
+        double p50 = 0.0;
+        double p99 = 0.0;
+        double p999 = 0.0;
+        double max = 0.0;
+
+        static LatencySummary of(const LatencyHistogram &histogram)
+        {
+                if (histogram.total == 0) {
+                        return {};
+                }
+                return {static_cast<double>(histogram.total),
+                        histogram.mean(),
+                        histogram.min,
+                        histogram.percentile(50.0),
+                        histogram.percentile(99.0),
+                        histogram.percentile(99.9),
+                        histogram.max};
+        }
+};
+
+// Global and per-rank latency summaries, only valid on root
+struct LatencyReport {
+        LatencySummary global{};
+        std::vector<LatencySummary> ranks;
+};
+
+// Summarize the local histogram on every process and merge all of them on root
+inline LatencyReport reduce_latencies(const LatencyHistogram &local, const int root = 0, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        LatencyReport report;
+        if (rank == root) {
+                report.ranks.resize(csize);
+        }
+
+        const LatencySummary summary = LatencySummary::of(local);
+        MPI_Gather(&summary,
+                   sizeof(LatencySummary),
+                   MPI_BYTE,
+                   report.ranks.data(),
+                   sizeof(LatencySummary),
+                   MPI_BYTE,
+                   root,
+                   comm);
+
+        LatencyHistogram global;
+        reduce_histograms(local, global, root, comm);
+        if (rank == root) {
+                report.global = LatencySummary::of(global);
+        }
+        return report;
+}
+
+inline void print_latencies(const LatencyReport &report, const long long msg_size, const long long iter)
+{
+        // @formatter:off
+        std::ostringstream oss1;
+        oss1 << std::left << std::setw(25) << ""
+                         << std::setw(20) << "Avg Latency (μs)"
+                         << std::setw(20) << "Min Latency (μs)"
+                         << std::setw(20) << "P50 Latency (μs)"
+                         << std::setw(20) << "P99 Latency (μs)"
+                         << std::setw(20) << "P99.9 Latency (μs)"
+                         << std::setw(20) << "Max Latency (μs)"
+                         << std::endl;
+        for (size_t i = 0; i < report.ranks.size(); ++i) {
+                const LatencySummary &s = report.ranks[i];
+                oss1 << std::left << std::setw(25) << "Rank " + std::to_string(i)
+                                 << std::setw(20) << s.avg * 1e6
+                                 << std::setw(20) << s.min * 1e6
+                                 << std::setw(20) << s.p50 * 1e6
+                                 << std::setw(20) << s.p99 * 1e6
+                                 << std::setw(20) << s.p999 * 1e6
+                                 << std::setw(20) << s.max * 1e6
+                                 << std::endl;
+        }
+        std::cout << oss1.str() << std::endl;
+
+        const LatencySummary &g = report.global;
+        std::ostringstream oss2;
+        oss2 << std::left << std::setw(25) << "Global messages count"
+                         << std::setw(20) << "Avg Latency (μs)"
+                         << std::setw(20) << "Min Latency (μs)"
+                         << std::setw(20) << "P50 Latency (μs)"
+                         << std::setw(20) << "P99 Latency (μs)"
+                         << std::setw(20) << "P99.9 Latency (μs)"
+                         << std::setw(20) << "Max Latency (μs)"
+                         << std::setw(20) << "Iterations"
+                         << std::endl
+                         << std::setw(25) << msg_size
+                         << std::setw(20) << g.avg * 1e6
+                         << std::setw(20) << g.min * 1e6
+                         << std::setw(20) << g.p50 * 1e6
+                         << std::setw(20) << g.p99 * 1e6
+                         << std::setw(20) << g.p999 * 1e6
+                         << std::setw(20) << g.max * 1e6
+                         << std::setw(20) << iter
+                         << std::endl
+                         << std::endl;
+        std::cout << oss2.str() << std::endl;
+        // @formatter:on
+}
+
+// Percentiles are written next to the latency file, e.g. out.csv -> out-percentiles.csv
+inline std::string percentiles_filename(const std::string &filename)
+{
+        std::filesystem::path path(filename);
+        path.replace_filename(path.stem().string() + "-percentiles" + path.extension().string());
+        return path.string();
+}
+
+// Write global and per-rank percentiles in seconds, only called on root
+inline void save_percentiles(const std::string &filename, const LatencyReport &report, const bool verbose = false)
+{
+        const std::string fpercentiles = percentiles_filename(filename);
+        std::ofstream out_file(fpercentiles);
+        if (!out_file) {
+                std::cerr << "ERROR: Unable to open file " << fpercentiles << " for writing." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        auto write_row = [&](const std::string &name, const LatencySummary &s)
+        {
+                out_file << name << ","
+                         << static_cast<long long>(s.count) << ","
+                         << std::fixed << std::setprecision(9) << s.avg << ","
+                         << s.min << ","
+                         << s.p50 << ","
+                         << s.p99 << ","
+                         << s.p999 << ","
+                         << s.max << "\n";
+        };
+
+        out_file << "Rank,Count,Avg,Min,P50,P99,P999,Max\n";
+        write_row("all", report.global);
+        for (size_t i = 0; i < report.ranks.size(); ++i) {
+                write_row(std::to_string(i), report.ranks[i]);
+        }
+        out_file.close();
+
+        if (verbose) {
+                std::cout << "Percentiles saved to " << fpercentiles << std::endl;
+        }
+}
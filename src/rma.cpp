@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <vector>
+#include <string>
+
+#include <mpi.h>
+
+#include "matrix.hpp"
+#include "options.hpp"
+#include "output.hpp"
+#include "persistent.hpp"
+#include "report.hpp"
+#include "rma.hpp"
+#include "stream.hpp"
+#include "timing.hpp"
+#include "volume.hpp"
+
+template <typename T>
+class Rma {
+
+        int rank;
+        int csize;
+
+        std::vector<int> counts;
+        std::vector<int> displs;
+
+        TimestampArena times;
+        StreamWriter stream;
+        LatencyHistogram histogram;
+        LatencyReport report;
+        VolumeReport volume;
+
+        static MPI_Datatype get_mpi_type() {
+                if constexpr (std::is_same_v<T, int>) {
+                        return MPI_INT;
+                } else if constexpr (std::is_same_v<T, double>) {
+                        return MPI_DOUBLE;
+                } else if constexpr (std::is_same_v<T, char>) {
+                        return MPI_CHAR;
+                }
+                return MPI_DATATYPE_NULL;
+        }
+
+        // Fill the blocks on the sending side, block i holds the value i + 1
+        void fill(RmaExchange &exchange, const RmaPattern pattern) const
+        {
+                T *sendbuf = static_cast<T *>(exchange.sendbuf());
+                if (pattern == RmaPattern::gatherv) {
+                        std::fill_n(sendbuf, counts[rank], static_cast<T>(rank + 1));
+                } else if (rank == 0) {
+                        for (int i = 0; i < csize; ++i) {
+                                std::fill_n(sendbuf + displs[i], counts[i], static_cast<T>(i + 1));
+                        }
+                }
+        }
+
+        // Run op once on a cleared receive buffer and check the blocks on the receiving side
+        template <typename F>
+        void verify(RmaExchange &exchange, const RmaPattern pattern, F &&op)
+        {
+                T *recvbuf = static_cast<T *>(exchange.recvbuf());
+                const bool scatter = pattern == RmaPattern::scatterv;
+                const long long total = std::accumulate(counts.begin(), counts.end(), 0LL);
+                const long long size = scatter ? counts[rank] : (rank == 0 ? total : 0);
+                std::fill_n(recvbuf, size, static_cast<T>(0));
+                MPI_Barrier(MPI_COMM_WORLD);
+                op();
+
+                bool valid = true;
+                for (int i = 0; i < csize; ++i) {
+                        if (scatter ? i != rank : rank != 0) {
+                                continue;
+                        }
+                        const T *block = recvbuf + (scatter ? 0 : displs[i]);
+                        const T expected = static_cast<T>(i + 1);
+                        valid = valid && std::all_of(block, block + counts[i], [&](const T x) { return x == expected; });
+                }
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Received payload does not match the send buffer" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
+public:
+
+        explicit Rma(const std::string &filename)
+        {
+                rank = -1;
+                csize = -1;
+
+                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+
+                if (rank == 0 && csize < 2) {
+                        std::cerr << "ERROR: Need more than one process." << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                // Counts are read as 64-bit integers, but MPI_Put and MPI_Get take int counts
+                const std::vector<long long> counts_ll = load_counts(filename);
+                if (std::accumulate(counts_ll.begin(), counts_ll.end(), 0LL) > INT_MAX) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Displacements exceed the range of int" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                counts.assign(counts_ll.begin(), counts_ll.end());
+
+                displs.resize(csize);
+                displs[0] = 0;
+                for (int i = 1; i < csize; ++i) {
+                        displs[i] = displs[i - 1] + counts[i - 1];
+                }
+        }
+
+        void run(const Options &options)
+        {
+                const std::optional<RmaVariant> variant = parse_rma_variant(options.algorithm);
+                if (!variant) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Unknown algorithm " << options.algorithm << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                if (options.mode != Mode::blocking) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: One-sided exchanges are only available in blocking mode" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                // Window creation is a one-time cost, like the init of a persistent collective
+                std::optional<RmaExchange> exchange;
+                const double init = timed_init([&]
+                {
+                        exchange.emplace(*variant, counts.data(), displs.data(), get_mpi_type());
+                }, options.timer);
+
+                auto op = [&]
+                {
+                        exchange->run();
+                };
+
+                // Check the payload once, outside of the timed iterations
+                fill(*exchange, variant->pattern);
+                verify(*exchange, variant->pattern, op);
+
+                auto record = [&](auto &&f)
+                {
+                        if (options.stream) {
+                                stream.open(stream_filename(options.foutput, rank),
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                                measure(f, options, stream, histogram);
+                                stream.finish();
+                        } else {
+                                measure(f, options, times, histogram);
+                        }
+                };
+
+                record(op);
+
+                const long long iter = static_cast<long long>(histogram.total);
+
+                std::vector<long long> call_times(csize);
+                MPI_Gather(&iter, 1, MPI_LONG_LONG, call_times.data(), 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+                if (rank == 0) {
+                        // @formatter:off
+                        if (!std::ranges::all_of(
+                                call_times.begin(),
+                                call_times.end(),
+                                [&](const long long x)
+                                {
+                                    return x == call_times[0];
+                                })) {
+                                std::cerr << "ERROR: Timing buffers mismatch: "
+                                             "Process has different number of iterations in starts"
+                                          << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                        // @formatter:on
+                }
+
+                // Merge histograms for global percentiles, summarize each rank for local ones
+                report = reduce_latencies(histogram);
+
+                // Root egress of a scatterv, root ingress of a gatherv
+                const long long all = std::accumulate(counts.begin(), counts.end(), 0LL);
+                const long long root_bytes = (all - counts[0]) * static_cast<long long>(sizeof(T));
+                const long long own_bytes = rank == 0 ? 0 : counts[rank] * static_cast<long long>(sizeof(T));
+                const bool scatter = variant->pattern == RmaPattern::scatterv;
+                const long long out = rank == 0 ? (scatter ? root_bytes : 0) : (scatter ? 0 : own_bytes);
+                const long long in = rank == 0 ? (scatter ? 0 : root_bytes) : (scatter ? own_bytes : 0);
+                volume = gather_volume(out, in);
+
+                if (rank == 0 && options.verbose) {
+                        long long msg_size = 0;
+                        for (int i = 0; i < csize; ++i) {
+                                msg_size += counts[i];
+                        }
+                        print_latencies(report, msg_size, iter);
+                        print_volume(volume, report);
+                }
+                if (options.verbose) {
+                        print_init(init);
+                }
+
+                exchange.reset();
+                MPI_Barrier(MPI_COMM_WORLD);
+        }
+
+        // Save data to file
+        void save_latencies(const Options &options) const
+        {
+                const std::string &filename = options.foutput;
+
+                if (histogram.total == 0) {
+                        std::cerr << "ERROR: Must run first before saving" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                if (options.stream) {
+                        // Timestamps were already written while running
+                        report_stream(stream, options.foutput, options.verbose);
+                        if (rank == 0) {
+                                save_percentiles(filename, report, options.verbose);
+                                save_volume(filename, volume, report, options.verbose);
+                        }
+                        return;
+                }
+
+                switch (options.output_mode) {
+                case OutputMode::csv:
+                        write_csv(filename, times);
+                        break;
+                case OutputMode::parallel_csv:
+                        write_csv_mpiio(filename, times);
+                        break;
+                case OutputMode::parallel_binary:
+                        write_results_mpiio(filename,
+                                            times,
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                        break;
+                }
+
+                if (rank == 0) {
+                        save_percentiles(filename, report, options.verbose);
+                        save_volume(filename, volume, report, options.verbose);
+                }
+
+                if (rank == 0 && options.verbose) {
+                        std::cout << "Latencies saved to " << filename << std::endl;
+                }
+        }
+};
+
+
+int main(int argc, char *argv[])
+{
+        init_mpi(argc, argv);
+
+        Options options;
+        if (const auto status = parse_options(argc, argv, "rma", options)) {
+                MPI_Finalize();
+                return *status;
+        }
+
+        try {
+                if (options.dtype == "double") {
+                        Rma<double> benchmark(options.fmessages);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else if (options.dtype == "int") {
+                        Rma<int> benchmark(options.fmessages);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else if (options.dtype == "char") {
+                        Rma<char> benchmark(options.fmessages);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else {
+                        std::cerr << "Unknown dtype option: " << options.dtype << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        return EXIT_FAILURE;
+                }
+        } catch (const std::exception &e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                return EXIT_FAILURE;
+        }
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+}
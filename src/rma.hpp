@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+// Collective that the one-sided operations emulate, root is the only process with all blocks
+enum class RmaPattern {
+        scatterv,
+        gatherv,
+};
+
+enum class RmaOperation {
+        // The process with the data writes it into the window of the other side
+        put,
+        // The process without the data reads it from the window of the other side
+        get,
+};
+
+enum class RmaSync {
+        // MPI_Win_fence on all processes before and after the operations
+        fence,
+        // Generalized active target, MPI_Win_start/complete on origins, MPI_Win_post/wait on targets
+        pscw,
+        // Passive target, one MPI_Win_lock_all epoch for the lifetime of the window, every
+        // iteration ends with MPI_Win_flush_all and puts notify their targets with a barrier
+        lock,
+};
+
+struct RmaVariant {
+        RmaPattern pattern;
+        RmaOperation operation;
+        RmaSync sync;
+};
+
+// Parse <pattern>-<operation>-<sync>, e.g. scatterv-put-fence, the default if name is empty
+inline std::optional<RmaVariant> parse_rma_variant(const std::string &name)
+{
+        const std::string variant = name.empty() ? "scatterv-put-fence" : name;
+        const size_t first = variant.find('-');
+        const size_t second = variant.find('-', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+                return std::nullopt;
+        }
+        const std::string pattern = variant.substr(0, first);
+        const std::string operation = variant.substr(first + 1, second - first - 1);
+        const std::string sync = variant.substr(second + 1);
+
+        RmaVariant result{};
+        if (pattern == "scatterv") {
+                result.pattern = RmaPattern::scatterv;
+        } else if (pattern == "gatherv") {
+                result.pattern = RmaPattern::gatherv;
+        } else {
+                return std::nullopt;
+        }
+        if (operation == "put") {
+                result.operation = RmaOperation::put;
+        } else if (operation == "get") {
+                result.operation = RmaOperation::get;
+        } else {
+                return std::nullopt;
+        }
+        if (sync == "fence") {
+                result.sync = RmaSync::fence;
+        } else if (sync == "pscw") {
+                result.sync = RmaSync::pscw;
+        } else if (sync == "lock") {
+                result.sync = RmaSync::lock;
+        } else {
+                return std::nullopt;
+        }
+        return result;
+}
+
+// Irregular scatter or gather of blocks with MPI_Put or MPI_Get. Counts and displacements are in
+// elements of type, as for MPI_Scatterv and MPI_Gatherv. The side that is accessed exposes its
+// buffer in a window from MPI_Win_allocate, the other side keeps a local buffer, so depending on
+// the variant the send or the receive buffer is window memory. Root copies its own block locally.
+class RmaExchange {
+        RmaVariant variant;
+        const int *counts;
+        const int *displs;
+        MPI_Datatype type;
+        int root;
+        MPI_Comm comm;
+        int rank = -1;
+        int csize = -1;
+        MPI_Aint extent = 0;
+
+        MPI_Win win = MPI_WIN_NULL;
+        char *window = nullptr;
+        std::vector<char> local;
+
+        // Root pushes with put in a scatter and pulls with get in a gather, every other process
+        // is then a target, otherwise it is the other way round
+        bool root_origin = false;
+        bool origin = false;
+        MPI_Group origins = MPI_GROUP_NULL;
+        MPI_Group targets = MPI_GROUP_NULL;
+
+        // Operations of an origin, root accesses every other process and they access root
+        void access()
+        {
+                if (!origin) {
+                        return;
+                }
+                const bool scatter = variant.pattern == RmaPattern::scatterv;
+                char *buffer = local.data();
+                if (rank == root) {
+                        for (int i = 0; i < csize; ++i) {
+                                if (i == root || counts[i] == 0) {
+                                        continue;
+                                }
+                                if (scatter) {
+                                        MPI_Put(buffer + displs[i] * extent, counts[i], type, i, 0, counts[i], type, win);
+                                } else {
+                                        MPI_Get(buffer + displs[i] * extent, counts[i], type, i, 0, counts[i], type, win);
+                                }
+                        }
+                } else if (counts[rank] > 0) {
+                        if (scatter) {
+                                MPI_Get(buffer, counts[rank], type, root, displs[rank], counts[rank], type, win);
+                        } else {
+                                MPI_Put(buffer, counts[rank], type, root, displs[rank], counts[rank], type, win);
+                        }
+                }
+        }
+
+        // Block of root from its send to its receive buffer, one of which is the window
+        void copy_root()
+        {
+                const size_t bytes = static_cast<size_t>(counts[root]) * extent;
+                if (rank != root || bytes == 0) {
+                        return;
+                }
+                const char *send = static_cast<const char *>(sendbuf());
+                char *recv = static_cast<char *>(recvbuf());
+                if (variant.pattern == RmaPattern::scatterv) {
+                        std::memcpy(recv, send + displs[root] * extent, bytes);
+                } else {
+                        std::memcpy(recv + displs[root] * extent, send, bytes);
+                }
+        }
+
+public:
+        RmaExchange(const RmaVariant variant,
+                    const int *counts,
+                    const int *displs,
+                    const MPI_Datatype type,
+                    const int root = 0,
+                    const MPI_Comm comm = MPI_COMM_WORLD) : variant(variant),
+                                                            counts(counts),
+                                                            displs(displs),
+                                                            type(type),
+                                                            root(root),
+                                                            comm(comm)
+        {
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &csize);
+                MPI_Aint lb;
+                MPI_Type_get_extent(type, &lb, &extent);
+
+                const bool scatter = variant.pattern == RmaPattern::scatterv;
+                root_origin = scatter == (variant.operation == RmaOperation::put);
+                origin = (rank == root) == root_origin;
+
+                // Root holds every block on its side of the collective, and every process its own one
+                const MPI_Aint all = std::accumulate(counts, counts + csize, MPI_Aint{0});
+                const MPI_Aint own = counts[rank];
+                const MPI_Aint sendsize = scatter ? (rank == root ? all : 0) : own;
+                const MPI_Aint recvsize = scatter ? own : (rank == root ? all : 0);
+
+                // The window is on the accessed side, i.e. the receive buffer of a put and the
+                // send buffer of a get
+                const MPI_Aint exposed = variant.operation == RmaOperation::put ? recvsize : sendsize;
+                local.resize((variant.operation == RmaOperation::put ? sendsize : recvsize) * extent);
+                MPI_Win_allocate(exposed * extent,
+                                 static_cast<int>(extent),
+                                 MPI_INFO_NULL,
+                                 comm,
+                                 &window,
+                                 &win);
+
+                MPI_Group group;
+                MPI_Comm_group(comm, &group);
+                MPI_Group single, others;
+                MPI_Group_incl(group, 1, &root, &single);
+                MPI_Group_excl(group, 1, &root, &others);
+                MPI_Group_free(&group);
+                origins = root_origin ? single : others;
+                targets = root_origin ? others : single;
+
+                if (variant.sync == RmaSync::lock) {
+                        MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+                }
+        }
+
+        RmaExchange(const RmaExchange &) = delete;
+        RmaExchange &operator=(const RmaExchange &) = delete;
+
+        ~RmaExchange()
+        {
+                if (variant.sync == RmaSync::lock) {
+                        MPI_Win_unlock_all(win);
+                }
+                MPI_Win_free(&win);
+                MPI_Group_free(&origins);
+                MPI_Group_free(&targets);
+        }
+
+        void *sendbuf()
+        {
+                return variant.operation == RmaOperation::put ? static_cast<void *>(local.data()) : window;
+        }
+
+        void *recvbuf()
+        {
+                return variant.operation == RmaOperation::put ? window : static_cast<void *>(local.data());
+        }
+
+        // One scatter or gather, every block is in place on return
+        void run()
+        {
+                switch (variant.sync) {
+                case RmaSync::fence:
+                        MPI_Win_fence(MPI_MODE_NOPRECEDE, win);
+                        access();
+                        copy_root();
+                        MPI_Win_fence(MPI_MODE_NOSUCCEED, win);
+                        break;
+                case RmaSync::pscw:
+                        if (origin) {
+                                MPI_Win_start(targets, 0, win);
+                                access();
+                                MPI_Win_complete(win);
+                        } else {
+                                MPI_Win_post(origins, 0, win);
+                                MPI_Win_wait(win);
+                        }
+                        copy_root();
+                        break;
+                case RmaSync::lock:
+                        access();
+                        if (origin) {
+                                MPI_Win_flush_all(win);
+                        }
+                        copy_root();
+                        if (variant.operation == RmaOperation::put) {
+                                // Targets only learn from the barrier that the data arrived
+                                MPI_Barrier(comm);
+                                MPI_Win_sync(win);
+                        }
+                        break;
+                }
+        }
+};
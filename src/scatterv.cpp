@@ -1,17 +1,31 @@
 #include <algorithm>
+#include <climits>
 #include <cmath>
-#include <deque>
-#include <fstream>
-#include <getopt.h>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
+#include <optional>
 #include <sstream>
 #include <vector>
 #include <string>
 
 #include <mpi.h>
 
+#include "algorithms.hpp"
+#include "largecount.hpp"
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "options.hpp"
+#include "output.hpp"
+#include "overlap.hpp"
+#include "persistent.hpp"
+#include "report.hpp"
+#include "segments.hpp"
+#include "stream.hpp"
+#include "synthetic.hpp"
+#include "timing.hpp"
+#include "volume.hpp"
+
 template <typename T>
 class Scatterv {
 
@@ -21,10 +35,25 @@ class Scatterv {
         T *sbuffer;
         T *rbuffer;
 
+        // Counts and displacements of MPI_Scatterv, only valid without --large-count
         int *displs;
         int *sendcounts;
 
-        std::deque<double> times {};
+        // Same counts and displacements for the large-count variant
+        std::vector<MPI_Count> sendcounts_c;
+        std::vector<MPI_Aint> displs_c;
+
+        // Rounds of the send buffer of root, a single one holds the whole distribution
+        Segmentation segmentation;
+
+        // Pages behind the send buffer of root with --synthetic
+        SyntheticBuffer synthetic;
+
+        TimestampArena times;
+        StreamWriter stream;
+        LatencyHistogram histogram;
+        LatencyReport report;
+        VolumeReport volume;
 
         static MPI_Datatype get_mpi_type() {
                 if constexpr (std::is_same_v<T, int>) {
@@ -37,9 +66,57 @@ class Scatterv {
                 return MPI_DATATYPE_NULL;
         }
 
+        // Every block in slices, one MPI_Scatterv per round from the send buffer of one round
+        void scatter_rounds(const Segmentation &plan, const bool large_count)
+        {
+                for (int r = 0; r < plan.rounds; ++r) {
+                        T *slice = rbuffer + plan.offset(rank, r);
+                        if (large_count) {
+                                scatterv_c(sbuffer,
+                                           plan.counts[r].data(),
+                                           plan.displs.data(),
+                                           get_mpi_type(),
+                                           slice,
+                                           plan.counts[r][rank],
+                                           get_mpi_type(),
+                                           0,
+                                           MPI_COMM_WORLD);
+                        } else {
+                                MPI_Scatterv(sbuffer,
+                                             plan.counts_int[r].data(),
+                                             plan.displs_int.data(),
+                                             get_mpi_type(),
+                                             slice,
+                                             plan.counts_int[r][rank],
+                                             get_mpi_type(),
+                                             0,
+                                             MPI_COMM_WORLD);
+                        }
+                }
+        }
+
+        // Run op once on a cleared receive buffer and check that every process got its block of
+        // the send buffer, where block i holds the value i + 1
+        template <typename F>
+        void verify(F &&op)
+        {
+                std::fill_n(rbuffer, sendcounts_c[rank], static_cast<T>(0));
+                op();
+
+                const T expected = static_cast<T>(rank + 1);
+                bool valid = std::all_of(rbuffer, rbuffer + sendcounts_c[rank], [&](const T x) { return x == expected; });
+                MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+                if (!valid) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Received payload does not match the send buffer" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+        }
+
 public:
 
-        explicit Scatterv(const std::string &filename)
+        Scatterv(const std::string &filename, const bool large_count, const int segments, const bool use_synthetic)
         {
                 rank = -1;
                 csize = -1;
@@ -57,82 +134,113 @@ public:
                         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
 
-                sendcounts = new int[csize];
-                if (rank == 0) {
-                        std::ifstream file(filename);
-                        if (!file) {
-                                std::cerr << "ERROR: Could not open file " << filename << std::endl;
-                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                        }
-
-                        std::string line;
-                        if (!std::getline(file, line)) {
-                                std::cerr << "ERROR: Could not read line " << filename << std::endl;
-                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-                        }
-
-                        std::istringstream ss(line);
-                        std::vector<int> row;
-                        std::string val;
-                        while (std::getline(ss, val, ',')) {
-                                row.push_back(std::stoi(val));
-                        }
-                        file.close();
-
-                        if (row.size() != csize) {
-                                // @formatter:off
-                                std::cerr << "ERROR: Number of columns "
-                                          << "(" << row.size() << ") "
-                                          << "does not match number of processes "
-                                          << "(" << csize << ")." << std::endl;
-                                // @formatter:on
-                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                const std::vector<long long> counts = load_counts(filename);
+                const long long msg_size = std::accumulate(counts.begin(), counts.end(), 0LL);
+                if (!large_count && msg_size > INT_MAX) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Displacements exceed the range of int, use --large-count" << std::endl;
                         }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
 
+                sendcounts_c.assign(counts.begin(), counts.end());
+                displs_c.resize(csize);
+                displs_c[0] = 0;
+                for (int i = 1; i < csize; ++i) {
+                        displs_c[i] = displs_c[i - 1] + sendcounts_c[i - 1];
+                }
 
-                        int msg_size = std::accumulate(row.begin(), row.end(), 0);
-                        sbuffer = new T[msg_size];
-                        int value = 1, offset = 0;
-                        for (int i : row) {
-                                std::fill_n(sbuffer + offset, i, static_cast<T>(value));
-                                offset += i;
-                                ++value;
-                        }
-
-                        for (int i = 0; i < row.size(); ++i) {
-                                sendcounts[i] = row[i];
-                        }
+                sendcounts = new int[csize];
+                displs = new int[csize];
+                for (int i = 0; i < csize; ++i) {
+                        sendcounts[i] = static_cast<int>(sendcounts_c[i]);
+                        displs[i] = static_cast<int>(displs_c[i]);
                 }
 
-                MPI_Bcast(sendcounts, csize, MPI_INT, 0, MPI_COMM_WORLD);
-                rbuffer = new T[sendcounts[rank]];
+                // Split the send buffer of root into rounds if the buffers exceed the memory
+                const long long own = sendcounts_c[rank] * static_cast<long long>(sizeof(T));
+                const long long all = rank == 0 && !use_synthetic ? msg_size * static_cast<long long>(sizeof(T)) : 0;
+                const int rounds = segments > 0 ? segments : plan_rounds(own, all);
+                segmentation = Segmentation(sendcounts_c, cap_rounds(rounds, sendcounts_c));
+                if (rank == 0 && segments == 0 && segmentation.rounds > 1) {
+                        std::cerr << "WARNING: Send buffer exceeds the available memory, scattering in "
+                                  << segmentation.rounds << " rounds" << std::endl;
+                }
 
-                displs = new int[csize];
-                displs[0] = 0;
-                for (int i = 1; i < csize; ++i) {
-                        displs[i] = displs[i - 1] + sendcounts[i - 1];
+                // Slices of a round are at the same displacements in every round
+                if (rank == 0 && use_synthetic) {
+                        synthetic.map(segmentation.size * sizeof(T));
+                        sbuffer = static_cast<T *>(synthetic.data());
+                } else if (rank == 0) {
+                        sbuffer = new T[segmentation.size];
+                        for (int i = 0; i < csize; ++i) {
+                                std::fill_n(sbuffer + segmentation.displs[i], segmentation.chunks[i], static_cast<T>(i + 1));
+                        }
                 }
+                rbuffer = new T[sendcounts_c[rank]];
         }
 
         ~Scatterv() {
-                delete[] sbuffer;
+                if (!synthetic) {
+                        delete[] sbuffer;
+                }
                 delete[] rbuffer;
                 delete displs;
                 delete sendcounts;
         }
 
-        void run(const double max_seconds = 1, const bool verbose = false)
+        void run(const Options &options)
         {
-                // Global clock
-                double global_start_time = 0.0;
-                if (rank == 0) {
-                        global_start_time = MPI_Wtime();
+                const std::optional<ScattervAlgorithm> algorithm = parse_scatterv_algorithm(options.algorithm);
+                if (!algorithm) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Unknown algorithm " << options.algorithm << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
-                MPI_Bcast(&global_start_time, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                if (*algorithm != ScattervAlgorithm::library && options.mode != Mode::blocking) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: In-tree algorithms are only available in blocking mode" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                if (options.large_count && (*algorithm != ScattervAlgorithm::library || options.mode != Mode::blocking)) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Option --large-count requires the library algorithm in blocking mode" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                const bool segmented = segmentation.rounds > 1;
+                if (segmented && (*algorithm != ScattervAlgorithm::library || options.mode != Mode::blocking)) {
+                        if (rank == 0) {
+                                std::cerr << "ERROR: Rounds are only available for the library algorithm in blocking mode" << std::endl;
+                        }
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                ScattervSchedule schedule(*algorithm, sendcounts, displs, get_mpi_type());
 
-                MPI_Barrier(MPI_COMM_WORLD);
-                while (true) {
-                        const double t_start = MPI_Wtime();
+                auto op = [&]
+                {
+                        if (*algorithm != ScattervAlgorithm::library) {
+                                schedule.run(sbuffer, rbuffer);
+                                return;
+                        }
+                        if (segmented) {
+                                scatter_rounds(segmentation, options.large_count);
+                                return;
+                        }
+                        if (options.large_count) {
+                                scatterv_c(sbuffer,
+                                           sendcounts_c.data(),
+                                           displs_c.data(),
+                                           get_mpi_type(),
+                                           rbuffer,
+                                           sendcounts_c[rank],
+                                           get_mpi_type(),
+                                           0,
+                                           MPI_COMM_WORLD);
+                                return;
+                        }
                         MPI_Scatterv(sbuffer,
                                      sendcounts,
                                      displs,
@@ -142,33 +250,104 @@ public:
                                      get_mpi_type(),
                                      0,
                                      MPI_COMM_WORLD);
-                        const double t_stop = MPI_Wtime();
+                };
 
-                        times.push_back(t_start);
-                        times.push_back(t_stop);
+                // Check the payload once, outside of the timed iterations, a synthetic send buffer
+                // repeats one tile and holds no blocks to check
+                if (!options.synthetic) {
+                        verify(op);
+                }
 
-                        bool continue_loop = true;
-                        if (rank == 0) {
-                                const double elapsed_time = MPI_Wtime() - global_start_time;
-                                continue_loop = elapsed_time < max_seconds;
+                // Blocking reference and compute kernel of the non-blocking mode
+                double blocking = 0.0;
+                ComputeKernel kernel;
+                if (options.mode == Mode::nonblocking) {
+                        blocking = blocking_baseline(op, options);
+                        kernel = ComputeKernel::calibrate(options.compute > 0.0 ? options.compute : blocking);
+                }
+
+                auto nonblocking_op = [&]
+                {
+                        auto post = [&](MPI_Request *request)
+                        {
+                                MPI_Iscatterv(sbuffer,
+                                              sendcounts,
+                                              displs,
+                                              get_mpi_type(),
+                                              rbuffer,
+                                              sendcounts[rank],
+                                              get_mpi_type(),
+                                              0,
+                                              MPI_COMM_WORLD,
+                                              request);
+                        };
+                        return post_compute_wait(post, kernel, options.timer);
+                };
+
+                // Request of the persistent mode, created once from the same counts and displacements
+                MPI_Request request = MPI_REQUEST_NULL;
+                double init = 0.0;
+                if (options.mode == Mode::persistent) {
+                        init = timed_init([&]
+                        {
+                                scatterv_init(sbuffer,
+                                              sendcounts,
+                                              displs,
+                                              get_mpi_type(),
+                                              rbuffer,
+                                              sendcounts[rank],
+                                              get_mpi_type(),
+                                              0,
+                                              MPI_COMM_WORLD,
+                                              &request);
+                        }, options.timer);
+                }
+
+                auto persistent_op = [&]
+                {
+                        MPI_Start(&request);
+                        MPI_Wait(&request, MPI_STATUS_IGNORE);
+                };
+
+                auto record = [&](auto &&f)
+                {
+                        if (options.stream) {
+                                stream.open(stream_filename(options.foutput, rank),
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                                measure(f, options, stream, histogram);
+                                stream.finish();
+                        } else {
+                                measure(f, options, times, histogram);
                         }
-                        MPI_Bcast(&continue_loop, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-                        if (!continue_loop)
-                                break;
+                };
+
+                switch (options.mode) {
+                case Mode::blocking:
+                        record(op);
+                        break;
+                case Mode::nonblocking:
+                        record(nonblocking_op);
+                        break;
+                case Mode::persistent:
+                        record(persistent_op);
+                        MPI_Request_free(&request);
+                        break;
                 }
-                MPI_Barrier(MPI_COMM_WORLD);
 
-                const int iter = static_cast<int>(times.size()) / 2;
+                const long long iter = static_cast<long long>(histogram.total);
 
-                std::vector<int> call_times(csize);
-                MPI_Gather(&iter, 1, MPI_INT, call_times.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+                std::vector<long long> call_times(csize);
+                MPI_Gather(&iter, 1, MPI_LONG_LONG, call_times.data(), 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
 
                 if (rank == 0) {
                         // @formatter:off
                         if (!std::ranges::all_of(
                                 call_times.begin(),
                                 call_times.end(),
-                                [&](const int x)
+                                [&](const long long x)
                                 {
                                     return x == call_times[0];
                                 })) {
@@ -180,144 +359,105 @@ public:
                         // @formatter:on
                 }
 
-                std::vector<double> lat(iter);
-                for (int i = 0; i <= iter; ++i) {
-                        lat[i] = times[i+1] - times[i];
-                }
-
-                double min_local = *std::ranges::min_element(lat);
-                double max_local = *std::ranges::max_element(lat);
-                double avg_local = std::accumulate(lat.begin(), lat.end(), 0.0) / iter;
-
-                std::vector<double> min_locals(csize);
-                std::vector<double> max_locals(csize);
-                std::vector<double> avg_locals(csize);
-
-                // Perform the reduction to gather global min, max, and average
-                MPI_Gather(&min_local, 1, MPI_DOUBLE, min_locals.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&max_local, 1, MPI_DOUBLE, max_locals.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&avg_local, 1, MPI_DOUBLE, avg_locals.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+                // Merge histograms for global percentiles, summarize each rank for local ones
+                report = reduce_latencies(histogram);
 
+                // Root egress, every other process receives its block
+                const long long all = std::accumulate(sendcounts_c.begin(), sendcounts_c.end(), 0LL);
+                const long long out = rank == 0 ? (all - sendcounts_c[0]) * static_cast<long long>(sizeof(T)) : 0;
+                const long long in = rank == 0 ? 0 : sendcounts_c[rank] * static_cast<long long>(sizeof(T));
+                volume = gather_volume(out, in);
 
-                if (rank == 0 && verbose) {
-                        // Output local
-                        // @formatter:off
-                        std::ostringstream oss1;
-                        oss1 << std::left << std::setw(25) << ""
-                                         << std::setw(25) << "Avg Latency (μs)"
-                                         << std::setw(25) << "Min Latency (μs)"
-                                         << std::setw(25) << "Max Latency (μs)"
-                                         << std::endl;
+                if (rank == 0 && options.verbose) {
+                        long long msg_size = 0;
                         for (int i = 0; i < csize; ++i) {
-                                oss1 << std::left << std::setw(25) << "Rank " + std::to_string(i)
-                                                 << std::setw(25) << avg_locals[i] * 1e6
-                                                 << std::setw(25) << min_locals[i] * 1e6
-                                                 << std::setw(25) << max_locals[i] * 1e6
-                                                 << std::endl;
+                                msg_size += sendcounts_c[i];
                         }
-                        std::cout << oss1.str() << std::endl;
-                        // @formatter:on
-
-
-                        // Compute global min, max, average by iteration over all processes
-                        double min_global = *std::ranges::min_element(min_locals);
-                        double max_global = *std::ranges::max_element(max_locals);
-                        double avg_global = std::accumulate(avg_locals.begin(), avg_locals.end(), 0.0) / csize;
+                        print_latencies(report, msg_size, iter);
+                        print_volume(volume, report);
+                }
 
+                if (rank == 0 && options.verbose && options.mode == Mode::nonblocking) {
+                        print_overlap(blocking, kernel.seconds, report.global.avg);
+                }
+                if (options.verbose && options.mode == Mode::persistent) {
+                        print_init(init);
+                }
 
-                        int msg_size = 0;
-                        for (int i = 0; i < csize; ++i) {
-                                msg_size += sendcounts[i];
+                // Synthetic against a real send buffer, if the real one fits into memory
+                if (options.verbose && options.synthetic) {
+                        const long long bytes = rank == 0 ? segmentation.size * static_cast<long long>(sizeof(T)) : 0;
+                        if (fits_in_memory(bytes)) {
+                                std::vector<T> real(rank == 0 ? segmentation.size : 1, static_cast<T>(0));
+                                const double latency = blocking_baseline(op, options);
+                                T *const aliased = sbuffer;
+                                sbuffer = real.data();
+                                const double latency_real = blocking_baseline(op, options);
+                                sbuffer = aliased;
+                                if (rank == 0) {
+                                        print_synthetic(bytes, synthetic.resident(), latency_real, latency);
+                                }
+                        } else if (rank == 0) {
+                                std::cout << "Real send buffer of " << bytes << " bytes exceeds the available memory, not compared" << std::endl;
                         }
-                        // @formatter:off
-                        std::ostringstream oss2;
-                        oss2 << std::left << std::setw(25) << "Global messages count"
-                                         << std::setw(25) << "Avg Latency (μs)"
-                                         << std::setw(25) << "Min Latency (μs)"
-                                         << std::setw(25) << "Max Latency (μs)"
-                                         << std::setw(25) << "Iterations"
-                                         << std::endl
-                                         << std::setw(25) << msg_size
-                                         << std::setw(25) << avg_global * 1e6
-                                         << std::setw(25) << min_global * 1e6
-                                         << std::setw(25) << max_global * 1e6
-                                         << std::setw(25) << iter
-                                         << std::endl
-                                         << std::endl;
-                        std::cout << oss2.str() << std::endl;
-                        // @formatter:on
+                }
 
+                // Cost of the rounds, from the same distribution in twice as many rounds
+                if (options.verbose && segmented) {
+                        const Segmentation doubled(sendcounts_c, segmentation.rounds * 2);
+                        const double latency = blocking_baseline(op, options);
+                        const double latency_doubled = blocking_baseline([&] { scatter_rounds(doubled, options.large_count); }, options);
+                        if (rank == 0) {
+                                print_segmentation(segmentation.rounds, segmentation.size * static_cast<long long>(sizeof(T)), latency, latency_doubled);
+                        }
                 }
 
                 MPI_Barrier(MPI_COMM_WORLD);
         }
 
         // Save data to file
-        void save_latencies(const std::string &filename, const bool verbose = false) const
+        void save_latencies(const Options &options) const
         {
-                if (times.empty()) {
+                const std::string &filename = options.foutput;
+
+                if (histogram.total == 0) {
                         std::cerr << "ERROR: Must run first before saving" << std::endl;
                         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                 }
 
-                const int iter = static_cast<int>(times.size()) / 2;
-
-                if (rank == 0) {
-                        std::ofstream out_file(filename);
-                        if (!out_file) {
-                                std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
-                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                if (options.stream) {
+                        // Timestamps were already written while running
+                        report_stream(stream, options.foutput, options.verbose);
+                        if (rank == 0) {
+                                save_percentiles(filename, report, options.verbose);
+                                save_volume(filename, volume, report, options.verbose);
                         }
+                        return;
+                }
 
-                        out_file.seekp(0, std::ios::end);
-                        if (out_file.tellp() == 0) {
-                                out_file << "Rank,Iteration,Starttime,Endtime\n";
-                                out_file.flush();
-                        }
-                        for (int i = 0; i < iter; ++i) {
-                                out_file << rank << ","
-                                         << i << ","
-                                         << std::fixed << std::setprecision(8) << times[i] << ","
-                                         << std::fixed << std::setprecision(8) << times[i+1] << "\n";
-                        }
-                        out_file.close();
-                } else {
-                        // Needs to be contiguous memory block
-                        std::vector<double> vec_times(times.size());
-                        for (int i = 0; i < times.size(); ++i) {
-                                vec_times[i] = times[i];
-                        }
-                        MPI_Send(vec_times.data(), times.size(), MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+                switch (options.output_mode) {
+                case OutputMode::csv:
+                        write_csv(filename, times);
+                        break;
+                case OutputMode::parallel_csv:
+                        write_csv_mpiio(filename, times);
+                        break;
+                case OutputMode::parallel_binary:
+                        write_results_mpiio(filename,
+                                            times,
+                                            options.collective,
+                                            options.distribution(),
+                                            options.dtype,
+                                            options.timer);
+                        break;
                 }
 
                 if (rank == 0) {
-                        std::ofstream out_file(filename, std::ios::app);
-                        if (!out_file) {
-                                std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
-                                exit(EXIT_FAILURE);
-                        }
-
-                        for (int r = 1; r < csize; ++r) {
-                                std::vector<double> recv_vec_times(times.size());
-                                MPI_Recv(recv_vec_times.data(),
-                                         times.size(),
-                                         MPI_DOUBLE,
-                                         r,
-                                         0,
-                                         MPI_COMM_WORLD,
-                                         MPI_STATUS_IGNORE);
-
-                                for (int i = 0; i < iter; ++i) {
-                                        out_file << r << ","
-                                                 << i << ","
-                                                 << std::fixed << std::setprecision(8) << recv_vec_times[i] << ","
-                                                 << std::fixed << std::setprecision(8) << recv_vec_times[i+1] << "\n";
-                                }
-                        }
-                        out_file.close();
+                        save_percentiles(filename, report, options.verbose);
+                        save_volume(filename, volume, report, options.verbose);
                 }
 
-                if (rank == 0 && verbose) {
+                if (rank == 0 && options.verbose) {
                         std::cout << "Latencies saved to " << filename << std::endl;
                 }
         }
@@ -326,80 +466,29 @@ public:
 
 int main(int argc, char *argv[])
 {
-        int rank;
-        MPI_Init(&argc, &argv);
-        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-        const option long_options[] = {{"help", no_argument, nullptr, 'h'},
-                                       {"fmessages", required_argument, nullptr, 'm'},
-                                       {"foutput", required_argument, nullptr, 'o'},
-                                       {"timeout", required_argument, nullptr, 't'},
-                                       {"verbose", no_argument, nullptr, 'v'},
-                                        {"dtype", required_argument, nullptr, 'd'},
-                                       {nullptr, 0, nullptr, 0}};
-
-        std::string fmessages = "default_messages.txt";
-        std::string foutput = "default_output.txt";
-        int timeout = 10;
-        bool verbose = false;
-        std::string dtype = "double";
-
+        init_mpi(argc, argv);
 
-        int opt;
-
-        while ((opt = getopt_long(argc, argv, "hm:o:n:t:d:v", long_options, nullptr)) != -1) {
-                switch (opt) {
-                case 'h':
-                        // @formatter:off
-                        if (rank == 0) {
-                                std::cout << "Help: This program runs a MPI scatterv\n"
-                                          << "Options:\n"
-                                          << "  -h, --help            Show this help message\n"
-                                          << "  -m, --fmessages FILE  Specify file with messages (default: default_messages.txt)\n"
-                                          << "  -o, --foutput FILE    Specify output file (default: default_output.txt)\n"
-                                          << "  -t, --timeout NUM     Specify timeout value in seconds (default: 10)\n"
-                                          << "  -d, --dtype TYPE      Specify char for MPI_CHAR, double MPI_DOUBLE or int for MPI_INT32 (default: double)\n"
-                                          << "  -v, --verbose         Enable verbose mode\n";
-                                // @formatter:on
-                        }
-                        return EXIT_SUCCESS;
-                case 'm':
-                        fmessages = optarg;
-                        break;
-                case 'o':
-                        foutput = optarg;
-                        break;
-                case 'd':
-                        dtype = optarg;
-                        break;
-                case 'v':
-                        verbose = true;
-                        break;
-                case 't':
-                        timeout = std::stoi(optarg);
-                        break;
-                default:
-                        std::cerr << "Unknown option\n";
-                        std::cerr << optarg << std::endl;
-                        return EXIT_FAILURE;
-                }
+        Options options;
+        if (const auto status = parse_options(argc, argv, "scatterv", options)) {
+                MPI_Finalize();
+                return *status;
         }
 
         try {
-                if (dtype == "double") {
-                        Scatterv<double> benchmark(fmessages);
-                        benchmark.run(timeout, verbose);
-                        benchmark.save_latencies(foutput, verbose);
-                } else if (dtype == "int") {
-                        Scatterv<int> benchmark(fmessages);
-                        benchmark.run(timeout, verbose);
-                        benchmark.save_latencies(foutput, verbose);
-                } else if (dtype == "char") {
-                        Scatterv<char> benchmark(fmessages);
-                        benchmark.run(timeout, verbose);
-                        benchmark.save_latencies(foutput, verbose);
+                if (options.dtype == "double") {
+                        Scatterv<double> benchmark(options.fmessages, options.large_count, options.segments, options.synthetic);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else if (options.dtype == "int") {
+                        Scatterv<int> benchmark(options.fmessages, options.large_count, options.segments, options.synthetic);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
+                } else if (options.dtype == "char") {
+                        Scatterv<char> benchmark(options.fmessages, options.large_count, options.segments, options.synthetic);
+                        benchmark.run(options);
+                        benchmark.save_latencies(options);
                 } else {
-                        std::cerr << "Unknown dtype option: " << dtype << std::endl;
+                        std::cerr << "Unknown dtype option: " << options.dtype << std::endl;
                         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
                         return EXIT_FAILURE;
                 }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <mpi.h>
+
+// Rooted distribution split into rounds of smaller v-collectives. Block i moves in slices of at
+// most ceil(counts[i] / rounds) elements, slice r of every block in round r. Root keeps the slices
+// of one round at the same displacements in every round, so its buffer holds about 1 / rounds of
+// the distribution and one round fits into a buffer of the whole distribution.
+struct Segmentation {
+        int rounds = 1;
+        // Elements of block i per slice, only the last slices may be shorter
+        std::vector<MPI_Count> chunks;
+        // Displacement of block i in the buffer of one round
+        std::vector<MPI_Aint> displs;
+        // Elements of every block in every round
+        std::vector<std::vector<MPI_Count>> counts;
+        // Same counts and displacements for the collectives without large counts, only valid if
+        // the whole distribution fits into int
+        std::vector<int> displs_int;
+        std::vector<std::vector<int>> counts_int;
+        // Elements of the buffer of one round
+        MPI_Count size = 0;
+
+        Segmentation() = default;
+
+        Segmentation(const std::vector<MPI_Count> &blocks, const int rounds) : rounds(std::max(rounds, 1))
+        {
+                const size_t csize = blocks.size();
+                chunks.resize(csize);
+                displs.resize(csize);
+                displs_int.resize(csize);
+                for (size_t i = 0; i < csize; ++i) {
+                        chunks[i] = (blocks[i] + this->rounds - 1) / this->rounds;
+                        displs[i] = static_cast<MPI_Aint>(size);
+                        displs_int[i] = static_cast<int>(size);
+                        size += chunks[i];
+                }
+
+                counts.assign(this->rounds, std::vector<MPI_Count>(csize));
+                counts_int.assign(this->rounds, std::vector<int>(csize));
+                for (int r = 0; r < this->rounds; ++r) {
+                        for (size_t i = 0; i < csize; ++i) {
+                                counts[r][i] = std::clamp<MPI_Count>(blocks[i] - r * chunks[i], 0, chunks[i]);
+                                counts_int[r][i] = static_cast<int>(counts[r][i]);
+                        }
+                }
+        }
+
+        // Offset of slice r of block i in the whole block
+        [[nodiscard]] MPI_Count offset(const int i, const int r) const
+        {
+                return r * chunks[i];
+        }
+};
+
+// Rounds never exceed the largest block, otherwise some rounds would move nothing
+inline int cap_rounds(const int rounds, const std::vector<MPI_Count> &blocks)
+{
+        const MPI_Count largest = blocks.empty() ? 1 : *std::ranges::max_element(blocks);
+        return static_cast<int>(std::clamp<MPI_Count>(rounds, 1, std::max<MPI_Count>(largest, 1)));
+}
+
+// Latency cost of the segmentation, estimated from the mean latencies with rounds and with twice
+// as many rounds. If every round adds the same overhead, the difference is the overhead of rounds
+// rounds, and a single round would save all but one of them.
+inline void print_segmentation(const int rounds,
+                               const long long round_bytes,
+                               const double latency,
+                               const double doubled)
+{
+        const double cost = std::max(doubled - latency, 0.0) * (rounds - 1) / rounds;
+        // @formatter:off
+        std::ostringstream oss;
+        oss << std::left << std::setw(20) << "Rounds"
+                         << std::setw(20) << "Round Bytes"
+                         << std::setw(25) << "Latency (μs)"
+                         << std::setw(25) << "2x Rounds Latency (μs)"
+                         << std::setw(25) << "Segmentation Cost (μs)"
+                         << std::setw(25) << "Unsegmented Est. (μs)"
+                         << std::endl
+                         << std::setw(20) << rounds
+                         << std::setw(20) << round_bytes
+                         << std::setw(25) << latency * 1e6
+                         << std::setw(25) << doubled * 1e6
+                         << std::setw(25) << cost * 1e6
+                         << std::setw(25) << std::max(latency - cost, 0.0) * 1e6
+                         << std::endl;
+        std::cout << oss.str() << std::endl;
+        // @formatter:on
+}
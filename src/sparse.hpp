@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "persistent.hpp"
+
+// Tags of the NBX exchange, consecutive exchanges alternate between them. A process that already
+// left one exchange can send the messages of the next one while another process still receives,
+// but it cannot get two exchanges ahead.
+constexpr int NBX_TAG = 7101;
+
+enum class Exchange {
+        // MPI_Alltoallv over all pairs of processes
+        dense,
+        // MPI_Neighbor_alltoallv on a distributed graph of the pairs with nonzero counts
+        neighbor,
+        // Non-blocking consensus: synchronous sends to the peers with nonzero counts, receive
+        // whatever arrives until an MPI_Ibarrier entered after the last send completed finishes
+        nbx,
+};
+
+inline std::optional<Exchange> parse_exchange(const std::string &name)
+{
+        if (name.empty() || name == "library" || name == "dense") {
+                return Exchange::dense;
+        }
+        if (name == "neighbor") {
+                return Exchange::neighbor;
+        }
+        if (name == "nbx") {
+                return Exchange::nbx;
+        }
+        return std::nullopt;
+}
+
+// The sparse ways of exchanging the blocks of an alltoallv. Counts and displacements are in
+// elements of the datatype passed to the exchange, as for MPI_Alltoallv.
+class SparseExchange {
+        MPI_Comm graph = MPI_COMM_NULL;
+
+        // Compact counts and displacements of the graph neighbors
+        std::vector<int> sources;
+        std::vector<int> destinations;
+        std::vector<int> graph_sendcounts;
+        std::vector<int> graph_sdispls;
+        std::vector<int> graph_recvcounts;
+        std::vector<int> graph_rdispls;
+
+        std::vector<int> rdispls;
+        std::vector<MPI_Request> requests;
+        int round = 0;
+
+public:
+        // Share of the pairs of processes with a nonzero count, over the whole matrix
+        double density = 0.0;
+
+        SparseExchange(const std::vector<int> &sendcounts,
+                       const std::vector<int> &sdispls,
+                       const std::vector<int> &recvcounts,
+                       const std::vector<int> &rdispls,
+                       const MPI_Comm comm = MPI_COMM_WORLD) : rdispls(rdispls)
+        {
+                const int csize = static_cast<int>(sendcounts.size());
+                for (int i = 0; i < csize; ++i) {
+                        if (sendcounts[i] > 0) {
+                                destinations.push_back(i);
+                                graph_sendcounts.push_back(sendcounts[i]);
+                                graph_sdispls.push_back(sdispls[i]);
+                        }
+                        if (recvcounts[i] > 0) {
+                                sources.push_back(i);
+                                graph_recvcounts.push_back(recvcounts[i]);
+                                graph_rdispls.push_back(rdispls[i]);
+                        }
+                }
+                requests.resize(destinations.size());
+
+                long long nonzero = static_cast<long long>(destinations.size());
+                MPI_Allreduce(MPI_IN_PLACE, &nonzero, 1, MPI_LONG_LONG, MPI_SUM, comm);
+                density = static_cast<double>(nonzero) / (static_cast<double>(csize) * csize);
+
+                MPI_Dist_graph_create_adjacent(comm,
+                                               static_cast<int>(sources.size()),
+                                               sources.data(),
+                                               MPI_UNWEIGHTED,
+                                               static_cast<int>(destinations.size()),
+                                               destinations.data(),
+                                               MPI_UNWEIGHTED,
+                                               MPI_INFO_NULL,
+                                               0,
+                                               &graph);
+        }
+
+        SparseExchange(const SparseExchange &) = delete;
+        SparseExchange &operator=(const SparseExchange &) = delete;
+
+        ~SparseExchange()
+        {
+                if (graph != MPI_COMM_NULL) {
+                        MPI_Comm_free(&graph);
+                }
+        }
+
+        void neighbor(const void *sendbuf, void *recvbuf, const MPI_Datatype type) const
+        {
+                MPI_Neighbor_alltoallv(sendbuf,
+                                       graph_sendcounts.data(),
+                                       graph_sdispls.data(),
+                                       type,
+                                       recvbuf,
+                                       graph_recvcounts.data(),
+                                       graph_rdispls.data(),
+                                       type,
+                                       graph);
+        }
+
+        void ineighbor(const void *sendbuf, void *recvbuf, const MPI_Datatype type, MPI_Request *request) const
+        {
+                MPI_Ineighbor_alltoallv(sendbuf,
+                                        graph_sendcounts.data(),
+                                        graph_sdispls.data(),
+                                        type,
+                                        recvbuf,
+                                        graph_recvcounts.data(),
+                                        graph_rdispls.data(),
+                                        type,
+                                        graph,
+                                        request);
+        }
+
+        void neighbor_init(const void *sendbuf, void *recvbuf, const MPI_Datatype type, MPI_Request *request) const
+        {
+#ifdef PERSISTENT_COLLECTIVE
+                PERSISTENT_COLLECTIVE(Neighbor_alltoallv)(sendbuf,
+                                                          graph_sendcounts.data(),
+                                                          graph_sdispls.data(),
+                                                          type,
+                                                          recvbuf,
+                                                          graph_recvcounts.data(),
+                                                          graph_rdispls.data(),
+                                                          type,
+                                                          graph,
+                                                          MPI_INFO_NULL,
+                                                          request);
+#else
+                persistent_unavailable();
+#endif
+        }
+
+        // Receivers do not know their sources in advance, the message placed at the displacement
+        // of its source
+        void nbx(const void *sendbuf, void *recvbuf, const MPI_Datatype type, const MPI_Comm comm = MPI_COMM_WORLD)
+        {
+                MPI_Aint lb, extent;
+                MPI_Type_get_extent(type, &lb, &extent);
+                const int tag = NBX_TAG + round;
+                round = 1 - round;
+
+                for (size_t i = 0; i < destinations.size(); ++i) {
+                        MPI_Issend(static_cast<const char *>(sendbuf) + graph_sdispls[i] * extent,
+                                   graph_sendcounts[i],
+                                   type,
+                                   destinations[i],
+                                   tag,
+                                   comm,
+                                   &requests[i]);
+                }
+
+                MPI_Request barrier = MPI_REQUEST_NULL;
+                bool barrier_entered = false;
+                while (true) {
+                        int arrived;
+                        MPI_Status status;
+                        MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &arrived, &status);
+                        if (arrived) {
+                                int count;
+                                MPI_Get_count(&status, type, &count);
+                                MPI_Recv(static_cast<char *>(recvbuf) + rdispls[status.MPI_SOURCE] * extent,
+                                         count,
+                                         type,
+                                         status.MPI_SOURCE,
+                                         tag,
+                                         comm,
+                                         MPI_STATUS_IGNORE);
+                        }
+
+                        int done;
+                        if (barrier_entered) {
+                                MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+                                if (done) {
+                                        break;
+                                }
+                        } else {
+                                // All synchronous sends were matched, so every message of this
+                                // process has been received
+                                MPI_Testall(static_cast<int>(requests.size()), requests.data(), &done, MPI_STATUSES_IGNORE);
+                                if (done) {
+                                        MPI_Ibarrier(comm, &barrier);
+                                        barrier_entered = true;
+                                }
+                        }
+                }
+        }
+};
+
+// Density at which a sparse variant would be as fast as the dense collective. The dense
+// collective touches every pair regardless of the density, the sparse variants are assumed to
+// cost in proportion to the pairs with nonzero counts.
+inline double crossover_density(const double density, const double dense, const double sparse)
+{
+        if (sparse <= 0.0) {
+                return 1.0;
+        }
+        return std::clamp(density * dense / sparse, 0.0, 1.0);
+}
+
+inline void print_sparse(const double density, const double dense, const double neighbor, const double nbx)
+{
+        // @formatter:off
+        std::ostringstream oss1;
+        oss1 << std::left << std::setw(25) << "Density (%)"
+                          << std::setw(25) << "Alltoallv (μs)"
+                          << std::setw(25) << "Neighbor (μs)"
+                          << std::setw(25) << "NBX (μs)"
+                          << std::endl
+                          << std::setw(25) << density * 100.0
+                          << std::setw(25) << dense * 1e6
+                          << std::setw(25) << neighbor * 1e6
+                          << std::setw(25) << nbx * 1e6
+                          << std::endl;
+        std::cout << oss1.str() << std::endl;
+
+        std::ostringstream oss2;
+        oss2 << std::left << std::setw(25) << "Neighbor Crossover (%)"
+                          << std::setw(25) << "NBX Crossover (%)"
+                          << std::endl
+                          << std::setw(25) << crossover_density(density, dense, neighbor) * 100.0
+                          << std::setw(25) << crossover_density(density, dense, nbx) * 100.0
+                          << std::endl;
+        std::cout << oss2.str() << std::endl;
+        // @formatter:on
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mpi.h>
+
+#include "clocksync.hpp"
+#include "format.hpp"
+#include "timer.hpp"
+
+// Samples per block, two blocks of 2^16 samples bound the memory to 2 MiB per process
+constexpr size_t STREAM_BLOCK_SAMPLES = 1 << 16;
+
+// Per-process stream file next to the output file, e.g. out.csv -> out-rank3.stream
+inline std::string stream_filename(const std::string &filename, const int rank)
+{
+        std::filesystem::path path(filename);
+        path.replace_filename(path.stem().string() + "-rank" + std::to_string(rank) + ".stream");
+        return path.string();
+}
+
+// Append v as LEB128 variable-length integer
+inline void put_varint(std::vector<uint8_t> &out, uint64_t v)
+{
+        while (v >= 0x80) {
+                out.push_back(static_cast<uint8_t>(v | 0x80));
+                v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+}
+
+inline uint64_t zigzag(const int64_t v)
+{
+        return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+// Double-buffered timestamp store for runs of unbounded duration. The measurement loop fills one
+// block while a dedicated writer thread encodes the other one (see format.hpp) and appends it to
+// a per-process file. Only if the writer falls behind by a full block the loop has to wait, which
+// is counted as a stall.
+class StreamWriter {
+        std::vector<double> blocks[2];
+        size_t fill[2] = {0, 0};
+        int current = 0;
+        // Block handed to the writer, -1 if none
+        int pending = -1;
+        bool done = false;
+        // Set by the writer if a block could not be written, the measurement aborts on its next submit
+        bool failed = false;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread writer;
+
+        FILE *file = nullptr;
+        std::string filename;
+        StreamHeader header{};
+        ClockModel clock;
+        int64_t previous = 0;
+        std::vector<uint8_t> encoded;
+
+        size_t samples = 0;
+        size_t stalls = 0;
+        size_t bytes = 0;
+
+        // Returns false if the block could not be written
+        bool encode(const int b)
+        {
+                encoded.clear();
+                const auto n = static_cast<uint32_t>(fill[b]);
+                encoded.resize(2 * sizeof(uint32_t));
+                for (size_t i = 0; i < n; ++i) {
+                        const int64_t start = to_ticks(blocks[b][2 * i], header.base);
+                        const int64_t stop = to_ticks(blocks[b][2 * i + 1], header.base);
+                        put_varint(encoded, zigzag(start - previous));
+                        put_varint(encoded, zigzag(stop - start));
+                        previous = start;
+                }
+                const auto payload = static_cast<uint32_t>(encoded.size() - 2 * sizeof(uint32_t));
+                std::memcpy(encoded.data(), &n, sizeof(uint32_t));
+                std::memcpy(encoded.data() + sizeof(uint32_t), &payload, sizeof(uint32_t));
+
+                if (std::fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size()) {
+                        return false;
+                }
+                bytes += encoded.size();
+                return true;
+        }
+
+        // Only called on the main thread, MPI is initialized with MPI_THREAD_FUNNELED
+        [[noreturn]] void fail() const
+        {
+                std::cerr << "ERROR: Unable to write to file " << filename << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                std::abort();
+        }
+
+        void loop()
+        {
+                std::unique_lock lock(mutex);
+                while (true) {
+                        cv.wait(lock, [&] { return pending != -1 || done; });
+                        if (pending == -1) {
+                                break;
+                        }
+
+                        // After a failed write the remaining blocks are dropped until the main thread aborts
+                        const int b = pending;
+                        const bool skip = failed;
+                        lock.unlock();
+                        const bool written = skip || encode(b);
+                        lock.lock();
+
+                        failed = failed || !written;
+
+                        fill[b] = 0;
+                        pending = -1;
+                        cv.notify_all();
+                }
+        }
+
+        void submit()
+        {
+                bool error;
+                {
+                        std::unique_lock lock(mutex);
+                        if (pending != -1) {
+                                ++stalls;
+                                cv.wait(lock, [&] { return pending == -1; });
+                        }
+                        error = failed;
+                        pending = current;
+                }
+                if (error) {
+                        fail();
+                }
+                cv.notify_all();
+                current ^= 1;
+        }
+
+public:
+        StreamWriter() = default;
+        StreamWriter(const StreamWriter &) = delete;
+        StreamWriter &operator=(const StreamWriter &) = delete;
+
+        ~StreamWriter()
+        {
+                finish();
+        }
+
+        // Create the stream file and start the writer thread
+        void open(const std::string &fname,
+                  const std::string &collective,
+                  const std::string &distribution,
+                  const std::string &dtype,
+                  const Timer &timer)
+        {
+                int rank, csize;
+                MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+                MPI_Comm_size(MPI_COMM_WORLD, &csize);
+
+                filename = fname;
+                file = std::fopen(filename.c_str(), "wb");
+                if (file == nullptr) {
+                        std::cerr << "ERROR: Unable to open file " << filename << " for writing." << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                header = make_stream_header(rank, csize, timer.now());
+                set_field(header.collective, collective);
+                set_field(header.distribution, distribution);
+                set_field(header.dtype, dtype);
+                set_field(header.timer, timer_name(timer.kind));
+                header.timer_resolution = timer.resolution;
+                header.timer_overhead = timer.overhead;
+                std::fwrite(&header, sizeof(header), 1, file);
+
+                for (auto &block : blocks) {
+                        block.assign(2 * STREAM_BLOCK_SAMPLES, 0.0);
+                }
+                writer = std::thread(&StreamWriter::loop, this);
+        }
+
+        // Clock model stored in the header when the stream is closed, so that all blocks are
+        // mapped to the clock of rank 0 with the model of the whole run
+        void apply_clock(const ClockModel &model)
+        {
+                clock = model;
+        }
+
+        // Nothing to size up front, memory is bounded by the two blocks
+        void reserve(size_t) {}
+
+        void record(const double t_start, const double t_stop)
+        {
+                std::vector<double> &block = blocks[current];
+                block[2 * fill[current]] = t_start;
+                block[2 * fill[current] + 1] = t_stop;
+                ++samples;
+                if (++fill[current] == STREAM_BLOCK_SAMPLES) {
+                        submit();
+                }
+        }
+
+        // Flush the partially filled block and wait for the writer
+        void finish()
+        {
+                if (!writer.joinable()) {
+                        return;
+                }
+                if (fill[current] > 0) {
+                        submit();
+                }
+                {
+                        std::lock_guard lock(mutex);
+                        done = true;
+                }
+                cv.notify_all();
+                writer.join();
+                if (failed) {
+                        fail();
+                }
+
+                header.clock_reference = clock.reference;
+                header.clock_offset = clock.offset;
+                header.clock_drift = clock.drift;
+                if (std::fseek(file, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, file) != 1) {
+                        fail();
+                }
+                std::fclose(file);
+                file = nullptr;
+        }
+
+        // Blocks are flushed while running, a stream never fills up
+        [[nodiscard]] bool full() const noexcept
+        {
+                return false;
+        }
+
+        [[nodiscard]] bool empty() const noexcept
+        {
+                return samples == 0;
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+                return samples;
+        }
+
+        // Number of times the measurement had to wait for the writer
+        [[nodiscard]] size_t stall_count() const noexcept
+        {
+                return stalls;
+        }
+
+        [[nodiscard]] size_t bytes_written() const noexcept
+        {
+                return bytes;
+        }
+};
+
+// Sum up what the writers of all processes did, root tells the user where the streams are
+inline void report_stream(const StreamWriter &stream, const std::string &filename, const bool verbose = false)
+{
+        int rank, csize;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &csize);
+
+        unsigned long long local[2] = {stream.bytes_written(), stream.stall_count()};
+        unsigned long long total[2] = {0, 0};
+        MPI_Reduce(local, total, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        if (rank == 0 && total[1] > 0) {
+                std::cerr << "WARNING: Measurement waited " << total[1] << " times for the stream writer" << std::endl;
+        }
+        if (rank == 0 && verbose) {
+                std::cout << "Latencies streamed to " << stream_filename(filename, 0) << " to "
+                          << stream_filename(filename, csize - 1) << " (" << total[0] << " bytes)" << std::endl;
+        }
+}
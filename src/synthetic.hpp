@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <mpi.h>
+
+// Bytes of the memfd region that a synthetic buffer repeats
+constexpr size_t SYNTHETIC_TILE_BYTES = 4 * 1024 * 1024;
+// Mappings of a synthetic buffer, well below the default vm.max_map_count of 65530. Larger
+// buffers get larger tiles.
+constexpr size_t SYNTHETIC_MAX_TILES = 16384;
+
+// Large virtual buffer backed by a single small memfd region, which is mapped over and over with
+// MAP_FIXED | MAP_SHARED. A write to one tile shows up in all of them, so the contents only serve
+// for timing, but a buffer of many GiB takes one tile of physical memory.
+class SyntheticBuffer {
+        char *buffer = nullptr;
+        size_t bytes = 0;
+        size_t tile = 0;
+        int fd = -1;
+
+        void release()
+        {
+                if (buffer != nullptr) {
+                        munmap(buffer, bytes);
+                }
+                if (fd >= 0) {
+                        close(fd);
+                }
+                buffer = nullptr;
+                bytes = 0;
+                tile = 0;
+                fd = -1;
+        }
+
+public:
+        SyntheticBuffer() = default;
+        SyntheticBuffer(const SyntheticBuffer &) = delete;
+        SyntheticBuffer &operator=(const SyntheticBuffer &) = delete;
+
+        ~SyntheticBuffer()
+        {
+                release();
+        }
+
+        // Map at least n bytes, the tile is zeroed
+        void map(const size_t n)
+        {
+                release();
+
+                const size_t page = sysconf(_SC_PAGESIZE);
+                tile = std::max(SYNTHETIC_TILE_BYTES, (n + SYNTHETIC_MAX_TILES - 1) / SYNTHETIC_MAX_TILES);
+                tile = std::min(tile, std::max<size_t>(n, 1));
+                tile = (tile + page - 1) / page * page;
+                bytes = (std::max<size_t>(n, 1) + tile - 1) / tile * tile;
+
+                fd = memfd_create("synthetic", MFD_CLOEXEC);
+                if (fd < 0 || ftruncate(fd, static_cast<off_t>(tile)) != 0) {
+                        std::cerr << "ERROR: Could not create a memfd region: " << std::strerror(errno) << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+
+                // Reserve the whole range first, MAP_FIXED then only replaces this reservation
+                void *ptr = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (ptr == MAP_FAILED) {
+                        std::cerr << "ERROR: Could not reserve " << bytes << " bytes for a synthetic buffer" << std::endl;
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                buffer = static_cast<char *>(ptr);
+                for (size_t offset = 0; offset < bytes; offset += tile) {
+                        if (mmap(buffer + offset, tile, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                                std::cerr << "ERROR: Could not map tile " << offset / tile << " of a synthetic buffer: "
+                                          << std::strerror(errno) << std::endl;
+                                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                        }
+                }
+                std::memset(buffer, 0, tile);
+        }
+
+        [[nodiscard]] void *data() const noexcept
+        {
+                return buffer;
+        }
+
+        [[nodiscard]] explicit operator bool() const noexcept
+        {
+                return buffer != nullptr;
+        }
+
+        // Bytes of physical memory behind the buffer
+        [[nodiscard]] size_t resident() const noexcept
+        {
+                return tile;
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+                return bytes;
+        }
+};
+
+// Latency of the collective with a synthetic buffer against a real one of the same size.
+// Transports that register or pin memory see every tile as a new range of the same pages, which
+// can make the synthetic buffer faster or slower than a real one.
+inline void print_synthetic(const size_t bytes,
+                            const size_t resident,
+                            const double real,
+                            const double synthetic)
+{
+        // @formatter:off
+        std::ostringstream oss;
+        oss << std::left << std::setw(20) << "Buffer Bytes"
+                         << std::setw(20) << "Resident Bytes"
+                         << std::setw(25) << "Real Latency (μs)"
+                         << std::setw(25) << "Synthetic Latency (μs)"
+                         << std::setw(20) << "Difference (%)"
+                         << std::endl
+                         << std::setw(20) << bytes
+                         << std::setw(20) << resident
+                         << std::setw(25) << real * 1e6
+                         << std::setw(25) << synthetic * 1e6
+                         << std::setw(20) << (real > 0.0 ? (synthetic - real) / real * 100.0 : 0.0)
+                         << std::endl;
+        std::cout << oss.str() << std::endl;
+        // @formatter:on
+}
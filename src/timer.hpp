@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <optional>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define MPI_BENCHMARK_HAS_TSC 1
+#endif
+
+#include <mpi.h>
+
+// Trials of the startup calibration, the smallest observed value is used
+constexpr int TIMER_CALIBRATION_TRIALS = 10000;
+// Seconds spent on measuring the TSC frequency against CLOCK_MONOTONIC_RAW
+constexpr double TSC_CALIBRATION_SECONDS = 0.02;
+
+enum class TimerKind {
+        // MPI_Wtime as provided by the MPI library
+        wtime,
+        // clock_gettime(CLOCK_MONOTONIC_RAW), not slewed by NTP
+        monotonic_raw,
+        // Invariant time stamp counter, read with rdtsc at the start and rdtscp at the stop
+        tsc,
+};
+
+inline std::optional<TimerKind> parse_timer(const std::string &name)
+{
+        if (name == "wtime") {
+                return TimerKind::wtime;
+        }
+        if (name == "monotonic") {
+                return TimerKind::monotonic_raw;
+        }
+        if (name == "tsc") {
+                return TimerKind::tsc;
+        }
+        return std::nullopt;
+}
+
+inline std::string timer_name(const TimerKind kind)
+{
+        switch (kind) {
+        case TimerKind::monotonic_raw:
+                return "monotonic";
+        case TimerKind::tsc:
+                return "tsc";
+        default:
+                return "wtime";
+        }
+}
+
+inline int64_t monotonic_raw_ns() noexcept
+{
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Whether the CPU advertises a TSC that ticks at a constant rate in all power states
+inline bool invariant_tsc()
+{
+#ifdef MPI_BENCHMARK_HAS_TSC
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+                return false;
+        }
+        return (edx & (1u << 8)) != 0;
+#else
+        return false;
+#endif
+}
+
+// Clock of the measurement loop in seconds. Raw readings of the monotonic clock and the TSC are
+// taken relative to the time of the calibration, so that doubles keep nanosecond precision.
+// start() and stop() are fenced such that the timed call cannot be reordered around them.
+class Timer {
+        int64_t epoch = 0;
+        double seconds_per_tick = 1e-9;
+
+public:
+        TimerKind kind = TimerKind::wtime;
+        // Smallest observed difference of two distinct readings in seconds
+        double resolution = 0.0;
+        // Smallest observed time between start() and stop() with nothing in between in seconds,
+        // subtracted from every sample
+        double overhead = 0.0;
+
+        [[nodiscard]] double start() const noexcept
+        {
+                switch (kind) {
+                case TimerKind::monotonic_raw:
+                        return static_cast<double>(monotonic_raw_ns() - epoch) * 1e-9;
+#ifdef MPI_BENCHMARK_HAS_TSC
+                case TimerKind::tsc:
+                        _mm_lfence();
+                        return static_cast<double>(static_cast<int64_t>(__rdtsc()) - epoch) * seconds_per_tick;
+#endif
+                default:
+                        return MPI_Wtime();
+                }
+        }
+
+        [[nodiscard]] double stop() const noexcept
+        {
+#ifdef MPI_BENCHMARK_HAS_TSC
+                if (kind == TimerKind::tsc) {
+                        unsigned int aux;
+                        const auto ticks = static_cast<int64_t>(__rdtscp(&aux));
+                        _mm_lfence();
+                        return static_cast<double>(ticks - epoch) * seconds_per_tick;
+                }
+#endif
+                return start();
+        }
+
+        [[nodiscard]] double now() const noexcept
+        {
+                return start();
+        }
+
+        // Set up the backend and measure its resolution and overhead. Returns nothing if the
+        // backend is not usable on this machine.
+        static std::optional<Timer> calibrate(const TimerKind kind)
+        {
+                Timer timer;
+                timer.kind = kind;
+
+                if (kind == TimerKind::monotonic_raw) {
+                        timer.epoch = monotonic_raw_ns();
+                } else if (kind == TimerKind::tsc) {
+#ifdef MPI_BENCHMARK_HAS_TSC
+                        if (!invariant_tsc()) {
+                                return std::nullopt;
+                        }
+                        const int64_t ns_start = monotonic_raw_ns();
+                        const auto ticks_start = static_cast<int64_t>(__rdtsc());
+                        int64_t ns_stop;
+                        do {
+                                ns_stop = monotonic_raw_ns();
+                        } while (ns_stop - ns_start < static_cast<int64_t>(TSC_CALIBRATION_SECONDS * 1e9));
+                        const auto ticks_stop = static_cast<int64_t>(__rdtsc());
+
+                        timer.seconds_per_tick = static_cast<double>(ns_stop - ns_start) * 1e-9 /
+                                                 static_cast<double>(ticks_stop - ticks_start);
+                        timer.epoch = ticks_stop;
+#else
+                        return std::nullopt;
+#endif
+                }
+
+                double resolution = std::numeric_limits<double>::max();
+                double overhead = std::numeric_limits<double>::max();
+                for (int i = 0; i < TIMER_CALIBRATION_TRIALS; ++i) {
+                        const double t0 = timer.now();
+                        double t1;
+                        do {
+                                t1 = timer.now();
+                        } while (t1 == t0);
+                        resolution = std::min(resolution, t1 - t0);
+
+                        const double t_start = timer.start();
+                        const double t_stop = timer.stop();
+                        overhead = std::min(overhead, t_stop - t_start);
+                }
+                timer.resolution = resolution;
+                timer.overhead = std::max(overhead, 0.0);
+                return timer;
+        }
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+#include <mpi.h>
+
+#include "arena.hpp"
+#include "clocksync.hpp"
+#include "histogram.hpp"
+#include "memory.hpp"
+#include "options.hpp"
+
+// Share of the time budget spent on estimating the cost of one iteration
+constexpr double CALIBRATION_FRACTION = 0.05;
+// Upper bound of the calibration time for long runs
+constexpr double CALIBRATION_MAX_SECONDS = 1.0;
+// Upper bound of the number of iterations
+constexpr long long MAX_ITERATIONS = 1LL << 40;
+// Number of times the time budget is checked during the measurement
+constexpr int BUDGET_CHECKS = 100;
+// Iterations between two precision checks of --precision at most
+constexpr long long PRECISION_CHECK_INTERVAL = 1000;
+// Samples per process before the confidence interval of a percentile is trusted
+constexpr uint64_t PRECISION_MIN_SAMPLES = 100;
+
+// Estimate how many calls of op fit into max_seconds. The number of trial calls is doubled
+// until the slowest process spent enough time to extrapolate. The result is reduced with
+// MPI_MAX and thus identical on all processes.
+template <typename F>
+long long calibrate_iterations(F &&op, const double max_seconds, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        const double target = std::min(max_seconds * CALIBRATION_FRACTION, CALIBRATION_MAX_SECONDS);
+
+        long long trials = 1;
+        double spent = 0.0;
+        double elapsed = 0.0;
+        while (true) {
+                MPI_Barrier(comm);
+                const double t_start = MPI_Wtime();
+                for (long long i = 0; i < trials; ++i) {
+                        op();
+                }
+                const double local = MPI_Wtime() - t_start;
+                MPI_Allreduce(&local, &elapsed, 1, MPI_DOUBLE, MPI_MAX, comm);
+                spent += elapsed;
+
+                if (elapsed >= target || trials >= MAX_ITERATIONS) {
+                        break;
+                }
+                trials *= 2;
+        }
+
+        const double per_iteration = std::max(elapsed / trials, 1e-9);
+        const double remaining = std::max(max_seconds - spent, 0.0);
+        return static_cast<long long>(std::clamp(remaining / per_iteration, 1.0, static_cast<double>(MAX_ITERATIONS)));
+}
+
+// Root decides whether the time budget is exhausted and tells everyone else
+inline bool budget_exceeded(const double global_start_time, const double max_seconds, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        bool exceeded = false;
+        if (rank == 0) {
+                exceeded = MPI_Wtime() - global_start_time >= max_seconds;
+        }
+        MPI_Bcast(&exceeded, 1, MPI_C_BOOL, 0, comm);
+        return exceeded;
+}
+
+// Root decides whether the time budget is exhausted. With options.precision every process also
+// checks whether the confidence interval of options.percentile is tight enough, the measurement
+// stops once this holds everywhere.
+inline bool stop_requested(const double global_start_time,
+                           const LatencyHistogram &histogram,
+                           const Options &options,
+                           const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        if (options.precision <= 0.0) {
+                return budget_exceeded(global_start_time, options.timeout, comm);
+        }
+
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        double state[2] = {0.0, std::numeric_limits<double>::infinity()};
+        if (rank == 0) {
+                state[0] = MPI_Wtime() - global_start_time >= options.timeout ? 1.0 : 0.0;
+        }
+        if (histogram.total >= PRECISION_MIN_SAMPLES) {
+                state[1] = histogram.percentile_error(options.percentile);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, state, 2, MPI_DOUBLE, MPI_MAX, comm);
+        return state[0] > 0.0 || state[1] <= options.precision;
+}
+
+// Root prints how precisely the percentile is known on the least precise process
+inline void report_precision(const LatencyHistogram &histogram, const Options &options, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        double error = histogram.percentile_error(options.percentile);
+        MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+        if (rank == 0 && error > options.precision) {
+                std::cerr << "WARNING: P" << options.percentile << " is only known to within +-" << error * 100.0
+                          << "% when the measurement ended" << std::endl;
+        }
+        if (rank == 0 && options.verbose) {
+                std::cout << "P" << options.percentile << " known to within +-" << error * 100.0 << "% after "
+                          << histogram.total << " iterations" << std::endl;
+        }
+}
+
+// Run op for options.warmup_iterations iterations and then for options.warmup_seconds on root, so
+// that connection setup, first touch and registration cache misses do not end up in the samples
+template <typename F>
+void warmup(F &&op, const Options &options, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        for (long long i = 0; i < options.warmup_iterations; ++i) {
+                op();
+        }
+        if (options.warmup_seconds > 0.0) {
+                const double warmup_start = MPI_Wtime();
+                do {
+                        op();
+                } while (!budget_exceeded(warmup_start, options.warmup_seconds, comm));
+        }
+}
+
+// How late processes entered the collective after the start of their window
+struct EntrySkew {
+        long long windows = 0;
+        // Windows that had already started when the previous iteration returned
+        long long missed = 0;
+        double sum = 0.0;
+        double max = 0.0;
+
+        void record(const double lateness) noexcept
+        {
+                ++windows;
+                sum += lateness;
+                max = std::max(max, lateness);
+        }
+};
+
+// Root prints the mean and largest lateness over all processes and warns about missed windows.
+// Windows and missed windows are both summed over all processes.
+inline void report_skew(const EntrySkew &skew, const bool verbose, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        const double local[2] = {skew.sum / std::max(skew.windows, 1LL), skew.max};
+        double sum[2] = {0.0, 0.0};
+        double max[2] = {0.0, 0.0};
+        const long long counts[2] = {skew.windows, skew.missed};
+        long long total[2] = {0, 0};
+        MPI_Reduce(local, sum, 2, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(local, max, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+        MPI_Reduce(counts, total, 2, MPI_LONG_LONG, MPI_SUM, 0, comm);
+
+        if (rank == 0 && total[1] > 0) {
+                std::cerr << "WARNING: " << total[1] << " of " << total[0] << " windows of all processes were missed, "
+                          << "the window is shorter than the collective" << std::endl;
+        }
+        if (rank == 0 && verbose) {
+                std::cout << "Entry skew over " << total[0] << " windows of all processes, mean " << sum[0] / csize * 1e6
+                          << " us, max " << max[1] * 1e6 << " us" << std::endl;
+        }
+}
+
+// Run op a calibrated, fixed number of times and record start and stop time of each call into
+// times, as well as its latency into a histogram. times is either a TimestampArena that is sized
+// before the first iteration or a StreamWriter that flushes blocks in the background. The time
+// budget is only checked at BUDGET_CHECKS batch boundaries so that the stop check does not add a
+// collective to every iteration. Calls are timed with options.timer and its overhead is
+// subtracted from every sample. Unless disabled, clocks are synchronized against rank 0 before
+// and after the measurement and the recorded timestamps are mapped to the clock of rank 0.
+//
+// With options.window every process instead busy-waits until the synchronized clock reaches the
+// start of the window of the iteration, so that arrival patterns do not depend on the previous
+// iteration. The number of windows is fixed by the time budget and no stop check is needed.
+//
+// If op returns a latency in seconds, e.g. without the computation of the non-blocking mode, it is
+// recorded in the histogram instead of the time between start and stop.
+//
+// Warmup iterations run before the calibration and are not recorded. With options.precision the
+// stop check runs at least every PRECISION_CHECK_INTERVAL iterations and also ends the
+// measurement once the percentile is precise enough.
+template <typename F, typename Timestamps>
+void measure(F &&op,
+             const Options &options,
+             Timestamps &times,
+             LatencyHistogram &histogram,
+             const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        warmup(op, options, comm);
+
+        const double max_seconds = options.timeout;
+        const bool windowed = options.window > 0.0;
+        const double measure_start = MPI_Wtime();
+        long long iterations = calibrate_iterations(op, max_seconds, comm);
+
+        const Timer &timer = options.timer;
+        ClockModel clock;
+        if (options.clock_sync) {
+                clock = synchronize_clocks(timer, comm);
+        }
+
+        if (windowed) {
+                // Whatever the calibration and synchronization left of the budget on root
+                if (rank == 0) {
+                        const double remaining = max_seconds - (MPI_Wtime() - measure_start);
+                        iterations = static_cast<long long>(std::clamp(remaining / options.window, 1.0, static_cast<double>(MAX_ITERATIONS)));
+                }
+                MPI_Bcast(&iterations, 1, MPI_LONG_LONG, 0, comm);
+        }
+
+        // An arena is prefaulted for every iteration up front, so the run is cut short where its
+        // timestamps would no longer fit into memory. Streams keep two blocks only.
+        if constexpr (std::is_same_v<Timestamps, TimestampArena>) {
+                const long long capacity = affordable_samples(2 * sizeof(double), comm);
+                if (iterations > capacity) {
+                        if (rank == 0) {
+                                std::cerr << "WARNING: Timestamps of " << iterations << " iterations exceed the available memory, "
+                                          << "stopping after " << capacity << ", use --stream for longer runs" << std::endl;
+                        }
+                        iterations = capacity;
+                }
+        }
+
+        long long batch = std::max(1LL, iterations / BUDGET_CHECKS);
+        if (options.precision > 0.0) {
+                batch = std::min(batch, PRECISION_CHECK_INTERVAL);
+        }
+        times.reserve(iterations);
+        times.apply_clock(clock);
+        histogram = {};
+
+        // Global clock for the time budget and, on the timer of root, the start of the first window
+        // once the broadcast surely arrived everywhere
+        double schedule[2] = {0.0, 0.0};
+        if (rank == 0) {
+                schedule[0] = MPI_Wtime();
+                schedule[1] = timer.now() + std::max(options.window, 1e-3);
+        }
+        MPI_Bcast(schedule, 2, MPI_DOUBLE, 0, comm);
+        const double global_start_time = schedule[0];
+        const double first_window = schedule[1];
+        EntrySkew skew;
+
+        MPI_Barrier(comm);
+        // Capacity is the same everywhere, so all processes fill up in the same iteration
+        for (long long i = 1; i <= iterations && !times.full(); ++i) {
+                double deadline = 0.0;
+                if (windowed) {
+                        deadline = clock.to_local(first_window + static_cast<double>(i - 1) * options.window);
+                        if (timer.now() > deadline) {
+                                ++skew.missed;
+                        }
+                        while (timer.now() < deadline) {
+                        }
+                }
+
+                const double t_start = timer.start();
+                if constexpr (std::is_void_v<std::invoke_result_t<F &>>) {
+                        op();
+                        const double t_stop = std::max(timer.stop() - timer.overhead, t_start);
+                        times.record(t_start, t_stop);
+                        histogram.record(t_stop - t_start);
+                } else {
+                        // Op measured the part of the iteration that counts itself
+                        const double latency = op();
+                        times.record(t_start, std::max(timer.stop() - timer.overhead, t_start));
+                        histogram.record(latency);
+                }
+
+                if (windowed) {
+                        skew.record(t_start - deadline);
+                } else if (i % batch == 0 && i < iterations && stop_requested(global_start_time, histogram, options, comm)) {
+                        // Calibration is an estimate, so guard against running far over budget
+                        break;
+                }
+        }
+        MPI_Barrier(comm);
+
+        if (options.clock_sync) {
+                // Offsets at both ends of the run pin down the drift over its whole duration
+                clock = ClockModel::between(clock, synchronize_clocks(timer, comm));
+                times.apply_clock(clock);
+                if (options.verbose) {
+                        report_clocks(clock, comm);
+                }
+        }
+        if (rank == 0 && options.verbose) {
+                std::cout << "Timer " << timer_name(timer.kind) << ", resolution " << timer.resolution * 1e9
+                          << " ns, overhead " << timer.overhead * 1e9 << " ns subtracted" << std::endl;
+        }
+        if (windowed) {
+                report_skew(skew, options.verbose, comm);
+        }
+        if (options.precision > 0.0) {
+                report_precision(histogram, options, comm);
+        }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "report.hpp"
+
+// Bytes every process sends to and receives from other processes per iteration, the block a
+// process keeps for itself does not count. Only valid on root.
+struct VolumeReport {
+        std::vector<long long> bytes_out;
+        std::vector<long long> bytes_in;
+        // Bytes moved between processes per iteration, the sum over all senders
+        long long total = 0;
+
+        // Bytes on the busier direction of the link of rank i
+        [[nodiscard]] long long link(const size_t i) const
+        {
+                return std::max(bytes_out[i], bytes_in[i]);
+        }
+
+        // Share of the total volume that crosses the link of rank i, 100% for the root of a
+        // scatterv or gatherv
+        [[nodiscard]] double share(const size_t i) const
+        {
+                return total > 0 ? static_cast<double>(link(i)) / static_cast<double>(total) : 0.0;
+        }
+
+        // Rank with the most bytes on its link, it takes part until the last of them arrived
+        [[nodiscard]] size_t busiest() const
+        {
+                size_t busiest = 0;
+                for (size_t i = 1; i < bytes_out.size(); ++i) {
+                        if (link(i) > link(busiest)) {
+                                busiest = i;
+                        }
+                }
+                return busiest;
+        }
+};
+
+inline double effective_bandwidth(const long long bytes, const double seconds)
+{
+        return seconds > 0.0 ? static_cast<double>(bytes) / seconds : 0.0;
+}
+
+// Gather the bytes of every process on root
+inline VolumeReport gather_volume(const long long out, const long long in, const int root = 0, const MPI_Comm comm = MPI_COMM_WORLD)
+{
+        int rank, csize;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &csize);
+
+        VolumeReport volume;
+        if (rank == root) {
+                volume.bytes_out.resize(csize);
+                volume.bytes_in.resize(csize);
+        }
+        MPI_Gather(&out, 1, MPI_LONG_LONG, volume.bytes_out.data(), 1, MPI_LONG_LONG, root, comm);
+        MPI_Gather(&in, 1, MPI_LONG_LONG, volume.bytes_in.data(), 1, MPI_LONG_LONG, root, comm);
+        if (rank == root) {
+                volume.total = std::accumulate(volume.bytes_out.begin(), volume.bytes_out.end(), 0LL);
+        }
+        return volume;
+}
+
+// Bandwidth percentiles follow from the latency percentiles, the P99 bandwidth is the one the
+// slowest 1% of the iterations still reach. The total volume is divided by the latencies of the
+// busiest rank, processes with little or no data leave a rooted collective early.
+inline void print_volume(const VolumeReport &volume, const LatencyReport &report)
+{
+        // @formatter:off
+        std::ostringstream oss1;
+        oss1 << std::left << std::setw(25) << ""
+                         << std::setw(20) << "Bytes Out"
+                         << std::setw(20) << "Bytes In"
+                         << std::setw(20) << "Share (%)"
+                         << std::setw(20) << "P50 BW (GB/s)"
+                         << std::setw(20) << "P99 BW (GB/s)"
+                         << std::endl;
+        for (size_t i = 0; i < volume.bytes_out.size(); ++i) {
+                oss1 << std::left << std::setw(25) << "Rank " + std::to_string(i)
+                                 << std::setw(20) << volume.bytes_out[i]
+                                 << std::setw(20) << volume.bytes_in[i]
+                                 << std::setw(20) << volume.share(i) * 100.0
+                                 << std::setw(20) << effective_bandwidth(volume.link(i), report.ranks[i].p50) * 1e-9
+                                 << std::setw(20) << effective_bandwidth(volume.link(i), report.ranks[i].p99) * 1e-9
+                                 << std::endl;
+        }
+        std::cout << oss1.str() << std::endl;
+
+        const LatencySummary &g = report.ranks[volume.busiest()];
+        std::ostringstream oss2;
+        oss2 << std::left << std::setw(25) << "Total Bytes"
+                         << std::setw(20) << "Avg BW (GB/s)"
+                         << std::setw(20) << "P50 BW (GB/s)"
+                         << std::setw(20) << "P99 BW (GB/s)"
+                         << std::setw(20) << "P99.9 BW (GB/s)"
+                         << std::endl
+                         << std::setw(25) << volume.total
+                         << std::setw(20) << effective_bandwidth(volume.total, g.avg) * 1e-9
+                         << std::setw(20) << effective_bandwidth(volume.total, g.p50) * 1e-9
+                         << std::setw(20) << effective_bandwidth(volume.total, g.p99) * 1e-9
+                         << std::setw(20) << effective_bandwidth(volume.total, g.p999) * 1e-9
+                         << std::endl;
+        std::cout << oss2.str() << std::endl;
+        // @formatter:on
+}
+
+// Volume is written next to the latency file, e.g. out.csv -> out-volume.csv
+inline std::string volume_filename(const std::string &filename)
+{
+        std::filesystem::path path(filename);
+        path.replace_filename(path.stem().string() + "-volume" + path.extension().string());
+        return path.string();
+}
+
+// Write bytes per iteration, share and effective bandwidth percentiles in bytes per second of
+// every rank and of the total, only called on root
+inline void save_volume(const std::string &filename,
+                        const VolumeReport &volume,
+                        const LatencyReport &report,
+                        const bool verbose = false)
+{
+        const std::string fvolume = volume_filename(filename);
+        std::ofstream out_file(fvolume);
+        if (!out_file) {
+                std::cerr << "ERROR: Unable to open file " << fvolume << " for writing." << std::endl;
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        auto write_row = [&](const std::string &name,
+                             const long long out,
+                             const long long in,
+                             const double share,
+                             const long long bytes,
+                             const LatencySummary &s)
+        {
+                out_file << name << ","
+                         << out << ","
+                         << in << ","
+                         << std::fixed << std::setprecision(6) << share << ","
+                         << std::setprecision(0) << effective_bandwidth(bytes, s.avg) << ","
+                         << effective_bandwidth(bytes, s.p50) << ","
+                         << effective_bandwidth(bytes, s.p99) << ","
+                         << effective_bandwidth(bytes, s.p999) << "\n";
+        };
+
+        out_file << "Rank,Bytes Out,Bytes In,Share,Avg Bandwidth,P50 Bandwidth,P99 Bandwidth,P999 Bandwidth\n";
+        write_row("all", volume.total, volume.total, 1.0, volume.total, report.ranks[volume.busiest()]);
+        for (size_t i = 0; i < volume.bytes_out.size(); ++i) {
+                write_row(std::to_string(i), volume.bytes_out[i], volume.bytes_in[i], volume.share(i), volume.link(i), report.ranks[i]);
+        }
+        out_file.close();
+
+        if (verbose) {
+                std::cout << "Volume saved to " << fvolume << std::endl;
+        }
+}
@@ -28,23 +28,27 @@ def exponential(nproc: int, m2m: bool = False, savedir: str = ".", seed: int = 4
         values = np.random.exponential(50, size).astype(np.uintp)
         f = f"{savedir}/{nproc}{'-m2m' if m2m else ''}-exponential.csv"
         values = values.reshape(1, -1) if not m2m else values
-        np.savetxt(f, values.reshape(1,-1), delimiter=",", fmt="%d")
+        np.savetxt(f, values, delimiter=",", fmt="%d")
         return values, f
 
 
-def increasing(nproc: int, avg: int,  savedir: str = ".", seed: int = 42):
+def increasing(nproc: int, avg: int, m2m: bool = False, savedir: str = ".", seed: int = 42):
         np.random.seed(seed)
         values = np.floor((2 * avg * (np.arange(nproc) + 1)) / nproc).astype(np.uintp)
-        f = f"{savedir}/{nproc}-increasing.csv"
-        np.savetxt(f, values.reshape(1,-1), delimiter=",", fmt="%d")
+        f = f"{savedir}/{nproc}{'-m2m' if m2m else ''}-increasing.csv"
+        # Every rank sends the same increasing row
+        values = np.tile(values, (nproc, 1)) if m2m else values.reshape(1, -1)
+        np.savetxt(f, values, delimiter=",", fmt="%d")
         return values, f
 
 
-def decreasing(nproc: int, avg: int,  savedir: str = ".", seed: int = 42):
+def decreasing(nproc: int, avg: int, m2m: bool = False, savedir: str = ".", seed: int = 42):
         np.random.seed(seed)
         values = (np.floor((2 * avg * (nproc - np.arange(nproc))) / nproc) + 1).astype(np.uintp)
-        f = f"{savedir}/{nproc}-decreasing.csv"
-        np.savetxt(f, values.reshape(1,-1), delimiter=",", fmt="%d")
+        f = f"{savedir}/{nproc}{'-m2m' if m2m else ''}-decreasing.csv"
+        # Every rank sends the same decreasing row
+        values = np.tile(values, (nproc, 1)) if m2m else values.reshape(1, -1)
+        np.savetxt(f, values, delimiter=",", fmt="%d")
         return values, f
 
 
@@ -54,7 +58,7 @@ def zipfian(nproc: int, m2m: bool = False,  savedir: str = ".", seed: int = 42):
         values = np.random.zipf(2, size).astype(np.uintp)
         f = f"{savedir}/{nproc}{'-m2m' if m2m else ''}-zipfian.csv"
         values = values.reshape(1, -1) if not m2m else values
-        np.savetxt(f, values.reshape(1,-1), delimiter=",", fmt="%d")
+        np.savetxt(f, values, delimiter=",", fmt="%d")
         return values, f
 
 
@@ -74,7 +78,7 @@ def bucket(nproc: int, avg: int, m2m: bool = False, savedir: str = ".", seed: in
         values = (avg // 2) + np.random.randint(1, avg, size=size).astype(np.uintp)
         f = f"{savedir}/{nproc}{'-m2m' if m2m else ''}-bucket.csv"
         values = values.reshape(1, -1) if not m2m else values
-        np.savetxt(f, values.reshape(1,-1), delimiter=",", fmt="%d")
+        np.savetxt(f, values, delimiter=",", fmt="%d")
         return values, f
 
 
@@ -137,6 +141,7 @@ if __name__ == "__main__":
         increasing_parser = subparsers.add_parser('increasing', help='Generate increasing sequence')
         increasing_parser.add_argument('nproc', type=int, help="Number of processors")
         increasing_parser.add_argument('avg', type=int, help="Average block size")
+        increasing_parser.add_argument('--m2m', action='store_true', help="Many-to-many distribution")
         increasing_parser.add_argument('--seed', type=int, default=42, help="Random seed")
         increasing_parser.add_argument("--savedir", type=str, default=".", help="Save file to dir")
 
@@ -144,6 +149,8 @@ if __name__ == "__main__":
         decreasing_parser.add_argument('nproc', type=int, help="Number of processors")
         decreasing_parser.add_argument('avg', type=int, help="Average block size")
         decreasing_parser.add_argument('--m2m', action='store_true', help="Many-to-many distribution")
+        decreasing_parser.add_argument('--seed', type=int, default=42, help="Random seed")
+        decreasing_parser.add_argument("--savedir", type=str, default=".", help="Save file to dir")
 
         zipfian_parser = subparsers.add_parser('zipfian', help='Generate zipfian distribution')
         zipfian_parser.add_argument('nproc', type=int, help="Number of processors")
@@ -191,9 +198,9 @@ if __name__ == "__main__":
         elif args.command == 'exponential':
                 exponential(args.nproc, args.m2m, args.savedir, args.seed)
         elif args.command == 'increasing':
-                increasing(args.nproc, args.avg, args.savedir, args.seed)
+                increasing(args.nproc, args.avg, args.m2m, args.savedir, args.seed)
         elif args.command == 'decreasing':
-                decreasing(args.nproc, args.avg, args.savedir, args.seed)
+                decreasing(args.nproc, args.avg, args.m2m, args.savedir, args.seed)
         elif args.command == 'zipfian':
                 zipfian(args.nproc, args.m2m, args.savedir,  args.seed)
         elif args.command == 'uniform':
@@ -7,9 +7,58 @@ import seaborn as sns
 
 sns.set_style("whitegrid")
 
+# Binary result format written with --format binary, see src/format.hpp
+RESULT_MAGIC = b"MPIBENCH"
+RESULT_HEADER = np.dtype([("magic", "S8"),
+                          ("version", "<u4"),
+                          ("header_size", "<u4"),
+                          ("nproc", "<u4"),
+                          ("delta_size", "<u4"),
+                          ("samples", "<u8"),
+                          ("data_offset", "<u8"),
+                          ("resolution", "<f8"),
+                          ("collective", "S32"),
+                          ("distribution", "S256"),
+                          ("dtype", "S16"),
+                          ("timer", "S16"),
+                          ("timer_resolution", "<f8"),
+                          ("timer_overhead", "<f8"),
+                          ("mpi_library", "S640")])
+
+
+def read_binary(filename):
+    header = np.fromfile(filename, dtype=RESULT_HEADER, count=1)[0]
+    nproc, samples = int(header["nproc"]), int(header["samples"])
+    delta = np.dtype(f"<u{int(header['delta_size'])}")
+
+    base = np.fromfile(filename, dtype="<f8", count=nproc, offset=int(header["header_size"]))
+    columns = np.memmap(filename, dtype=delta, mode="r", offset=int(header["data_offset"]), shape=(2, nproc, samples))
+
+    ticks = np.cumsum(columns[0], axis=1, dtype=np.int64)
+    start = base[:, None] + ticks * header["resolution"]
+    end = base[:, None] + (ticks + columns[1]) * header["resolution"]
+    return pd.DataFrame({"Rank": np.repeat(np.arange(nproc, dtype=np.int16), samples),
+                         "Iteration": np.tile(np.arange(samples, dtype=np.int32), nproc),
+                         "Starttime": start.ravel(),
+                         "Endtime": end.ravel()})
+
+
+def read_results(filename):
+    with open(filename, "rb") as f:
+        if f.read(len(RESULT_MAGIC)) == RESULT_MAGIC:
+            return read_binary(filename)
+
+    head = {"Rank": np.int16,
+            "Iteration": np.int32,
+            "Starttime": np.float64,
+            "Endtime": np.float64}
+    return pd.read_csv(filename, dtype=head)
+
+
 def plot_dir(dirname: str):
     base = pathlib.Path(dirname)
-    files = [f for f in list(base.glob("*.csv")) if not f.name.split("-")[0].isdigit()]
+    files = [f for f in list(base.glob("*.csv")) + list(base.glob("*.bin"))
+             if not f.name.split("-")[0].isdigit() and not f.stem.endswith("-percentiles")]
     
     fig, axes = plt.subplots(len(files), 2, figsize=(18, 6*len(files)))
     for f, ax in zip(files, axes):
@@ -21,13 +70,10 @@ def plot_dir(dirname: str):
 
 def main(filename, ax):
     q = 0.95
-    head = {"Rank": np.int16,
-            "Iteration": np.int32,
-            "Starttime": np.float64,
-            "Endtime": np.float64}
+    filename = pathlib.Path(filename)
 
-    n, _ = filename.name.split(".")
-    df = pd.read_csv(filename, dtype=head)
+    n = filename.stem
+    df = read_results(filename)
     df["Latency"] = (df["Endtime"] - df["Starttime"]) * 1e6
 
     q95 = df[(df["Latency"] <= df["Latency"].quantile(q)) & (df["Latency"] >= df["Latency"].quantile(float(format(1-q, ".2f"))))].copy()
@@ -0,0 +1,383 @@
+import datetime
+import json
+import os
+import pathlib
+import shlex
+import shutil
+import subprocess
+
+from typing import Dict, List, Tuple
+
+import pandas as pd
+
+from data import *
+
+
+# Selectable algorithms of the library, Open MPI coll_tuned ids and MPICH CVAR values with the
+# name of the algorithm in a MPICH tuning file. Open MPI 4.1 coll_tuned has no rules for the
+# scatterv, gatherv and alltoallw collectives, MPICH only has a linear scatterv and gatherv.
+OPENMPI_ALGORITHMS = {
+        "allgatherv": {1: "default", 2: "bruck", 3: "ring", 4: "neighborexchange", 5: "two_proc"},
+        "alltoallv": {1: "basic_linear", 2: "pairwise"},
+        "bcast": {1: "basic_linear", 2: "chain", 3: "pipeline", 4: "split_binary_tree", 5: "binary_tree",
+                  6: "binomial", 7: "knomial", 8: "scatter_allgather", 9: "scatter_allgather_ring"},
+}
+
+MPICH_ALGORITHMS = {
+        "scatterv": {"linear": "MPIR_Scatterv_allcomm_linear"},
+        "gatherv": {"linear": "MPIR_Gatherv_allcomm_linear"},
+        "allgatherv": {"brucks": "MPIR_Allgatherv_intra_brucks",
+                       "recursive_doubling": "MPIR_Allgatherv_intra_recursive_doubling",
+                       "ring": "MPIR_Allgatherv_intra_ring"},
+        "alltoallv": {"pairwise_sendrecv_replace": "MPIR_Alltoallv_intra_pairwise_sendrecv_replace",
+                      "scattered": "MPIR_Alltoallv_intra_scattered"},
+        "alltoallw": {"pairwise_sendrecv_replace": "MPIR_Alltoallw_intra_pairwise_sendrecv_replace",
+                      "scattered": "MPIR_Alltoallw_intra_scattered"},
+        "bcast": {"binomial": "MPIR_Bcast_intra_binomial",
+                  "scatter_recursive_doubling_allgather": "MPIR_Bcast_intra_scatter_recursive_doubling_allgather",
+                  "scatter_ring_allgather": "MPIR_Bcast_intra_scatter_ring_allgather",
+                  "pipelined_tree": "MPIR_Bcast_intra_pipelined_tree",
+                  "tree": "MPIR_Bcast_intra_tree"},
+}
+
+# Collective ids of the Open MPI dynamic rules file, see COLLTYPE_T in coll_tuned.h
+OPENMPI_COLLTYPE = {"allgatherv": 1, "alltoallv": 4, "bcast": 7}
+
+# Open MPI looks up the rules of these collectives with message size 0, so only the first rule of
+# every communicator size ever applies
+OPENMPI_UNSIZED = {"alltoallv"}
+
+# Message size a MPICH tuning file compares against, bcast only knows the size of its one message
+MPICH_MSG_SIZE = {"bcast": "avg_msg_size"}
+
+DATATYPE_BYTES = {"char": 1, "int": 4, "double": 8}
+
+M2M_COLLECTIVES = ["alltoallv", "alltoallw"]
+
+DISTRIBUTIONS = ["equal", "normal", "exponential", "increasing", "decreasing", "zipfian", "uniform", "bucket",
+                 "spikes", "alternating", "two_blocks"]
+
+
+def shape(distribution: str, nproc: int, m2m: bool, savedir: str):
+        # Only the shape matters, the sizes are scaled to the total afterwards
+        avg = 100
+        if distribution == 'equal':
+                values, _ = equal(nproc, avg, m2m, savedir)
+        elif distribution == 'normal':
+                values, _ = normal(nproc, m2m, savedir)
+        elif distribution == 'exponential':
+                values, _ = exponential(nproc, m2m, savedir)
+        elif distribution == 'increasing':
+                values, _ = increasing(nproc, avg, m2m, savedir)
+        elif distribution == 'decreasing':
+                values, _ = decreasing(nproc, avg, m2m, savedir)
+        elif distribution == 'zipfian':
+                values, _ = zipfian(nproc, m2m, savedir)
+        elif distribution == 'uniform':
+                values, _ = uniform(nproc, avg, m2m, savedir)
+        elif distribution == 'bucket':
+                values, _ = bucket(nproc, avg, m2m, savedir)
+        elif distribution == 'spikes':
+                values, _ = spikes(nproc, avg, m2m=m2m, savedir=savedir)
+        elif distribution == 'alternating':
+                values, _ = alternating(nproc, avg, m2m, savedir)
+        elif distribution == 'two_blocks':
+                values, _ = two_blocks(nproc, avg, m2m, savedir)
+        else:
+                raise ValueError(f"Unknown distribution {distribution}")
+
+        values = np.asarray(values, dtype=np.float64)
+        return values.reshape((nproc, nproc) if m2m else (1, nproc))
+
+
+def generate_messages(distribution: str, nproc: int, total: int, m2m: bool, output: pathlib.Path):
+        # Scale the shape so that all blocks together hold total elements
+        values = shape(distribution, nproc, m2m, str(output))
+        if values.sum() == 0:
+                values = np.ones_like(values)
+        values = np.floor(values * total / values.sum()).astype(np.uintp)
+        f = output / f"{nproc}{'-m2m' if m2m else ''}-{distribution}-{total}.csv"
+        np.savetxt(f, values, delimiter=",", fmt="%d")
+        return f
+
+
+def algorithm_env(mpi_impl: str, collective: str, algorithm):
+        env = os.environ.copy()
+        if mpi_impl == "openmpi":
+                env["OMPI_MCA_coll_tuned_use_dynamic_rules"] = "1"
+                env[f"OMPI_MCA_coll_tuned_{collective}_algorithm"] = str(algorithm)
+        else:
+                env[f"MPIR_CVAR_{collective.upper()}_INTRA_ALGORITHM"] = str(algorithm)
+        return env
+
+
+def run_test(command: List[str], env: dict, verbose: bool):
+        # Some algorithms only support some numbers of processes, e.g. two_proc, a failed run
+        # removes the algorithm from its region instead of stopping the sweep
+        if verbose:
+                print(f"==> {' '.join(command)}", flush=True)
+        output = None if verbose else subprocess.DEVNULL
+        try:
+                subprocess.run(command, check=True, env=env, stdout=output, stderr=output)
+        except subprocess.CalledProcessError:
+                print(f"==> Got non-zero error code, skipping: {' '.join(command)}")
+                return False
+        return True
+
+
+def read_latency(foutput: pathlib.Path, collective: str, metric: str):
+        # Latencies in seconds per message size in bytes of the benchmark's summary
+        if collective == "bcast":
+                # The bcast curve only keeps the average and slowest process of every size
+                curve = pd.read_csv(foutput)
+                column = "Avg Latency" if metric == "median" else "Max Latency"
+                return dict(zip(curve["Bytes"], curve[column]))
+
+        percentiles = pd.read_csv(foutput.with_name(f"{foutput.stem}-percentiles{foutput.suffix}"))
+        row = percentiles[percentiles["Rank"].astype(str) == "all"].iloc[0]
+        return {None: float(row["P50" if metric == "median" else "P99"])}
+
+
+def sweep(collective: str,
+          mpi_impl: str,
+          executor: str,
+          launcher_args: List[str],
+          binary: pathlib.Path,
+          nprocs: List[int],
+          sizes: List[int],
+          distributions: List[str],
+          dtype: str,
+          timeout: int,
+          metric: str,
+          output: pathlib.Path,
+          verbose: bool):
+        algorithms = OPENMPI_ALGORITHMS if mpi_impl == "openmpi" else MPICH_ALGORITHMS
+        m2m = collective in M2M_COLLECTIVES
+        rows = []
+        for nproc in nprocs:
+                for total in sizes:
+                        # Bcast sweeps powers of two up to the largest count itself, the shape does not matter
+                        shapes = ["equal"] if collective == "bcast" else distributions
+                        for distribution in shapes:
+                                count = max(total // DATATYPE_BYTES[dtype], 1)
+                                # The bcast file holds its one largest message
+                                blocks = 1 if collective == "bcast" else nproc
+                                fmessages = generate_messages(distribution, blocks, count, m2m, output)
+                                for algorithm in algorithms[collective]:
+                                        name = f"{collective}-{nproc}p-{distribution}-{total}-{algorithm}"
+                                        foutput = output / f"{name}.csv"
+                                        launcher = [executor, "-n" if "srun" in executor else "-np", str(nproc)]
+                                        command = launcher + launcher_args + [str(binary),
+                                                                              "--fmessages", str(fmessages),
+                                                                              "--foutput", str(foutput),
+                                                                              "--timeout", str(timeout),
+                                                                              "--dtype", dtype]
+                                        if not run_test(command, algorithm_env(mpi_impl, collective, algorithm), verbose):
+                                                continue
+
+                                        for size, latency in read_latency(foutput, collective, metric).items():
+                                                rows.append({"nproc": nproc,
+                                                             "size": total if size is None else int(size),
+                                                             "distribution": distribution,
+                                                             "algorithm": algorithm,
+                                                             "latency": latency})
+        return pd.DataFrame(rows)
+
+
+def select(results: pd.DataFrame) -> Dict[int, List[Tuple[int, object]]]:
+        # A region is a number of processes and a total message size, an algorithm has to do well
+        # on every distribution shape, so it is scored by its slowest one
+        worst = results.groupby(["nproc", "size", "algorithm"])["latency"].max().reset_index()
+        best = worst.loc[worst.groupby(["nproc", "size"])["latency"].idxmin()]
+
+        decisions = {}
+        for nproc, group in best.groupby("nproc"):
+                group = group.sort_values("size")
+                decisions[int(nproc)] = [(int(size), algorithm) for size, algorithm in zip(group["size"], group["algorithm"])]
+        return decisions
+
+
+def select_unsized(results: pd.DataFrame) -> Dict[int, List[Tuple[int, object]]]:
+        # One rule per number of processes, scored by the slowest size and shape of the sweep
+        worst = results.groupby(["nproc", "algorithm"])["latency"].max().reset_index()
+        best = worst.loc[worst.groupby("nproc")["latency"].idxmin()]
+        return {int(nproc): [(0, algorithm)] for nproc, algorithm in zip(best["nproc"], best["algorithm"])}
+
+
+def boundaries(sizes: List[int]):
+        # Switch between two measured sizes at their geometric mean
+        return [int(np.sqrt(lower * upper)) for lower, upper in zip(sizes[:-1], sizes[1:])]
+
+
+def write_openmpi_rules(collective: str, decisions: Dict[int, List[Tuple[int, object]]], filename: pathlib.Path):
+        # A rule applies from its communicator and message size upwards, the first message size of
+        # every communicator size starts at 0 so that every message is covered
+        lines = ["1", f"{OPENMPI_COLLTYPE[collective]}", f"{len(decisions)}"]
+        for nproc, decision in sorted(decisions.items()):
+                starts = [0] + boundaries([size for size, _ in decision])
+                lines.append(f"{nproc}")
+                lines.append(f"{len(decision)}")
+                for start, (_, algorithm) in zip(starts, decision):
+                        lines.append(f"{start} {algorithm} 0 0")
+        filename.write_text("\n".join(lines) + "\n", encoding="utf8")
+
+
+def write_mpich_json(collective: str, decisions: Dict[int, List[Tuple[int, object]]], filename: pathlib.Path):
+        # A condition applies up to and including its value, the last one of every level is "any"
+        # so that sizes beyond the sweep keep the decision of the largest measured size
+        algorithms = MPICH_ALGORITHMS[collective]
+        msg_size = MPICH_MSG_SIZE.get(collective, "total_msg_size")
+
+        def by_size(decision):
+                ends = boundaries([size for size, _ in decision])
+                node = {f"{msg_size}<={end}": {f"algorithm={algorithms[algorithm]}": {}}
+                        for end, (_, algorithm) in zip(ends, decision)}
+                node["any"] = {f"algorithm={algorithms[decision[-1][1]]}": {}}
+                return node
+
+        nprocs = sorted(decisions)
+        intra = {}
+        for lower, upper in zip(nprocs[:-1], nprocs[1:]):
+                intra[f"comm_size<={(lower + upper) // 2}"] = by_size(decisions[lower])
+        intra["any"] = by_size(decisions[nprocs[-1]])
+
+        tuning = {f"collective={collective}": {"comm_type=intra": intra}}
+        filename.write_text(json.dumps(tuning, indent=4) + "\n", encoding="utf8")
+
+
+def main(collective: str,
+         executor: str,
+         launcher_args: List[str],
+         nprocs: List[int],
+         sizes: List[int],
+         distributions: List[str],
+         dtype: str = "double",
+         timeout: int = 1,
+         metric: str = "median",
+         wd: str = ".",
+         directory: str = "./results",
+         mpi_impl: str = 'openmpi',
+         verbose: bool = False
+         ):
+        start = datetime.datetime.now()
+
+        algorithms = OPENMPI_ALGORITHMS if mpi_impl == "openmpi" else MPICH_ALGORITHMS
+        if collective not in algorithms:
+                print(f"==> {mpi_impl} has no selectable algorithms for {collective}")
+                raise SystemExit(1)
+
+        binary = pathlib.Path(wd).absolute() / collective
+        if not binary.exists():
+                print(f"==> Could not find program {binary}")
+                raise SystemExit(1)
+
+        output = pathlib.Path(directory) / f"tuner-{collective}-{mpi_impl}-{start.strftime('%Y%m%d-%H%M%S')}"
+        output.mkdir(parents=True)
+        if verbose:
+                print(f"==> Created output directory: {output}")
+
+        results = sweep(collective, mpi_impl, executor, launcher_args, binary, nprocs, sorted(sizes), distributions,
+                        dtype, timeout, metric, output, verbose)
+        if results.empty:
+                print("==> No algorithm completed")
+                raise SystemExit(1)
+        results.to_csv(output / "tuning.csv", index=False)
+        unsized = mpi_impl == "openmpi" and collective in OPENMPI_UNSIZED
+        decisions = select_unsized(results) if unsized else select(results)
+
+        if mpi_impl == "openmpi":
+                rules = output / f"{collective}-rules.conf"
+                write_openmpi_rules(collective, decisions, rules)
+                deploy = (f"OMPI_MCA_coll_tuned_use_dynamic_rules=1 "
+                          f"OMPI_MCA_coll_tuned_dynamic_rules_filename={rules.absolute()}")
+        else:
+                rules = output / f"{collective}-tuning.json"
+                write_mpich_json(collective, decisions, rules)
+                deploy = f"MPIR_CVAR_COLL_SELECTION_TUNING_JSON_FILE={rules.absolute()}"
+
+        for nproc, decision in sorted(decisions.items()):
+                for size, algorithm in decision:
+                        name = algorithms[collective][algorithm] if mpi_impl == "openmpi" else algorithm
+                        print(f"==> {nproc} processes, {'all sizes' if unsized else f'{size} bytes'}: {name}")
+        print(f"==> Rules saved to {rules}, deploy with {deploy}")
+
+        if verbose:
+                now = datetime.datetime.now()
+                diff = (now - start).total_seconds()
+                print(f"==> Completed. Required {diff} seconds.")
+
+
+if __name__ == "__main__":
+        import argparse
+
+        parser = argparse.ArgumentParser(description="Select the fastest algorithm of the MPI library per number "
+                                                     "of processes and message size and write a decision file")
+        parser.add_argument("collective",
+                            choices=["scatterv", "gatherv", "allgatherv", "alltoallv", "alltoallw", "bcast"])
+        parser.add_argument("--nproc",
+                            type=int,
+                            nargs="+",
+                            default=[4],
+                            help="Numbers of processes to sweep (default: 4)")
+        parser.add_argument("--sizes",
+                            type=int,
+                            nargs="+",
+                            default=[1024, 65536, 1048576],
+                            help="Total message sizes in bytes to sweep, the largest one for bcast "
+                                 "(default: 1024 65536 1048576)")
+        parser.add_argument("--distributions",
+                            nargs="+",
+                            choices=DISTRIBUTIONS,
+                            default=["equal", "zipfian", "two_blocks"],
+                            help="Distribution shapes to sweep (default: equal zipfian two_blocks)")
+        parser.add_argument("--dtype",
+                            default="double",
+                            choices=list(DATATYPE_BYTES),
+                            help="Datatype of the messages (default: double)")
+        parser.add_argument("--timeout",
+                            type=int,
+                            default=1,
+                            help="Timeout of every run in seconds (default: 1)")
+        parser.add_argument("--metric",
+                            default="median",
+                            choices=["median", "p99"],
+                            help="Latency to minimize, average and slowest process for bcast (default: median)")
+        parser.add_argument("--directory",
+                            default="./results",
+                            help="Directory to save results and the decision file to (default: ./results)")
+        parser.add_argument("--executor",
+                            default="mpirun",
+                            choices=["mpirun", "srun"],
+                            help="The job launcher to use (default: mpirun)")
+        parser.add_argument("--launcher-args",
+                            default="",
+                            help="Extra arguments of the job launcher, e.g. \"--oversubscribe\" (default: none)")
+        parser.add_argument("--mpi-impl",
+                            default="openmpi",
+                            choices=["openmpi", "mpich"],
+                            help="MPI implementation to tune (default: openmpi)")
+        parser.add_argument("--wd",
+                            default='.',
+                            help="Working directory with binaries (default: .)")
+        parser.add_argument("--verbose",
+                            action='store_true',
+                            default=False,
+                            help="Print every command and its output (default: False)")
+        args = parser.parse_args()
+
+        e = shutil.which(args.executor)
+        assert e is not None, f"{args.executor} was not found in path"
+
+        main(collective=args.collective,
+             executor=e,
+             launcher_args=shlex.split(args.launcher_args),
+             nprocs=args.nproc,
+             sizes=args.sizes,
+             distributions=args.distributions,
+             dtype=args.dtype,
+             timeout=args.timeout,
+             metric=args.metric,
+             wd=args.wd,
+             directory=args.directory,
+             mpi_impl=args.mpi_impl,
+             verbose=args.verbose)